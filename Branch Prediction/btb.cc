@@ -0,0 +1,235 @@
+#include "btb.h"
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+TARGET_PREDICTOR::TARGET_PREDICTOR(UINT32 btbLogSets, UINT32 ways, UINT32 itcLogEntries,
+				   UINT32 rasDepth, UINT32 rasPolicy, UINT32 wrongPath){
+
+  btbSetMask = (1<<btbLogSets)-1;
+  btbWays    = ways;
+  useClock   = 0;
+
+  btb = new BTB_ENTRY[(btbSetMask+1)*btbWays];
+  for(UINT32 ii=0; ii< (btbSetMask+1)*btbWays; ii++){
+    btb[ii].PC      = 0;
+    btb[ii].target  = 0;
+    btb[ii].lastUse = 0;
+  }
+
+  itcMask     = (1<<itcLogEntries)-1;
+  pathHist    = 0;
+  targetCache = new UINT32[itcMask+1];
+  for(UINT32 ii=0; ii<= itcMask; ii++){
+    targetCache[ii]=0;
+  }
+
+  ras          = (rasDepth > 0) ? new RETURN_STACK(rasDepth, rasPolicy) : NULL;
+  rasWrongPath = wrongPath;
+
+  ResetStats();
+}
+
+TARGET_PREDICTOR::~TARGET_PREDICTOR(){
+  delete [] btb;
+  delete [] targetCache;
+  delete ras;
+}
+
+// clear the stats but keep the trained state, e.g. after a warmup
+void  TARGET_PREDICTOR::ResetStats(){
+  statTaken           = 0;
+  statBtbMiss         = 0;
+  statBtbWrong        = 0;
+  statIndirect        = 0;
+  statIndirectMispred = 0;
+  statReturn          = 0;
+  statReturnMispred   = 0;
+  statRasEmpty        = 0;
+  statRasWrongPath    = 0;
+  if(ras != NULL){
+    ras->ResetStats();
+  }
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+bool  TARGET_PREDICTOR::LookupBTB(UINT32 PC, UINT32 *target){
+  BTB_ENTRY *set = &btb[(PC & btbSetMask)*btbWays];
+
+  for(UINT32 ii=0; ii< btbWays; ii++){
+    if(set[ii].lastUse && set[ii].PC == PC){
+      set[ii].lastUse = ++useClock;
+      *target = set[ii].target;
+      return true;
+    }
+  }
+  return false;
+}
+
+void  TARGET_PREDICTOR::UpdateBTB(UINT32 PC, UINT32 target){
+  BTB_ENTRY *set    = &btb[(PC & btbSetMask)*btbWays];
+  BTB_ENTRY *victim = &set[0];
+
+  for(UINT32 ii=0; ii< btbWays; ii++){
+    if(set[ii].lastUse && set[ii].PC == PC){
+      victim = &set[ii];
+      break;
+    }
+    if(set[ii].lastUse < victim->lastUse){
+      victim = &set[ii];
+    }
+  }
+
+  victim->PC      = PC;
+  victim->target  = target;
+  victim->lastUse = ++useClock;
+}
+
+/////////////////////////////////////////////////////////////
+// Predict, then learn, the target of one branch. Not taken branches
+// need no target and always count as correct.
+/////////////////////////////////////////////////////////////
+
+bool  TARGET_PREDICTOR::ProcessBranch(const CBP_TRACE_RECORD *rec, bool dirMispred){
+  UINT32 predTarget = 0;
+  bool   correct;
+
+  if(ras != NULL && rasWrongPath != RAS_WRONG_PATH_OFF &&
+     rec->opType == OPTYPE_BRANCH_COND && dirMispred){
+    WrongPath(rec->PC);
+  }
+
+  switch(rec->opType){
+  case OPTYPE_BRANCH_COND:
+    if(!rec->branchTaken){
+      return true;
+    }
+    statTaken++;
+    correct = PredictDirect(rec);
+    break;
+
+  case OPTYPE_RET:
+    statTaken++;
+    correct = (ras != NULL) ? PredictReturn(rec) : PredictDirect(rec);
+    break;
+
+  case OPTYPE_BRANCH_UNCOND:
+  case OPTYPE_CALL_DIRECT:
+    statTaken++;
+    correct = PredictDirect(rec);
+    break;
+
+  case OPTYPE_INDIRECT_BR_CALL:{
+    UINT32 *itcEntry = &targetCache[(rec->PC ^ pathHist) & itcMask];
+
+    statTaken++;
+    statIndirect++;
+    predTarget = *itcEntry;
+    if(predTarget == 0){
+      LookupBTB(rec->PC, &predTarget);
+    }
+    correct = (predTarget == rec->branchTarget);
+    statIndirectMispred += !correct;
+
+    *itcEntry = rec->branchTarget;
+    UpdateBTB(rec->PC, rec->branchTarget);
+    break;
+  }
+
+  default:
+    return true;
+  }
+
+  // only taken branches reach here
+  if(ras != NULL && (rec->opType == OPTYPE_CALL_DIRECT || rec->opType == OPTYPE_INDIRECT_BR_CALL)){
+    ras->Push(rec->PC);
+  }
+
+  pathHist = (pathHist << ITC_PATH_SHIFT) ^ (rec->branchTarget >> 2);
+  return correct;
+}
+
+bool  TARGET_PREDICTOR::PredictDirect(const CBP_TRACE_RECORD *rec){
+  UINT32 predTarget = 0;
+  bool   correct    = true;
+
+  if(!LookupBTB(rec->PC, &predTarget)){
+    statBtbMiss++;
+    correct = false;
+  }else if(predTarget != rec->branchTarget){
+    statBtbWrong++;
+    correct = false;
+  }
+  UpdateBTB(rec->PC, rec->branchTarget);
+
+  return correct;
+}
+
+bool  TARGET_PREDICTOR::PredictReturn(const CBP_TRACE_RECORD *rec){
+  UINT32 predTarget = 0;
+  UINT32 callPC;
+  bool   correct;
+
+  statReturn++;
+  if(ras->Pop(&callPC)){
+    correct = IsReturnOf(callPC, rec->branchTarget);
+  }else{
+    statRasEmpty++;
+    correct = LookupBTB(rec->PC, &predTarget) && predTarget == rec->branchTarget;
+  }
+  statReturnMispred += !correct;
+  UpdateBTB(rec->PC, rec->branchTarget);
+
+  return correct;
+}
+
+/////////////////////////////////////////////////////////////
+// With -raswrongpath, a wrong path is made up after every mispredicted
+// conditional branch: two speculative returns pop the RAS, then a call
+// from the branch pushes its PC over the entry below the top. With
+// repair the checkpoint taken at the branch restores the pointer and the
+// top entry, but not the overwritten one, as in real designs.
+/////////////////////////////////////////////////////////////
+
+void  TARGET_PREDICTOR::WrongPath(UINT32 PC){
+  RAS_CHECKPOINT cp;
+  UINT32         callPC;
+
+  statRasWrongPath++;
+  ras->Checkpoint(&cp);
+  ras->Pop(&callPC);
+  ras->Pop(&callPC);
+  ras->Push(PC);
+
+  if(rasWrongPath == RAS_WRONG_PATH_REPAIR){
+    ras->Restore(&cp);
+  }
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+void  TARGET_PREDICTOR::PrintStats(UINT64 numInst){
+
+  printf("\nNUM_TAKEN_BR         \t : %10llu",   statTaken);
+  printf("\nNUM_TARGET_MISPRED   \t : %10llu",   GetNumTargetMispred());
+  printf("\nTARGET_MISPRED_PER_1K\t : %10.3f",   1000.0*(double)(GetNumTargetMispred())/(double)(numInst));
+  printf("\nBTB_MISSES           \t : %10llu",   statBtbMiss);
+  printf("\nBTB_WRONG_TARGET     \t : %10llu",   statBtbWrong);
+  printf("\nNUM_INDIRECT_BR      \t : %10llu",   statIndirect);
+  printf("\nINDIRECT_MISPRED     \t : %10llu",   statIndirectMispred);
+
+  if(ras != NULL){
+    printf("\nNUM_RETURNS          \t : %10llu",   statReturn);
+    printf("\nRETURN_MISPRED       \t : %10llu",   statReturnMispred);
+    printf("\nRETURN_CORRECT(%%)    \t : %10.3f",   100.0-100.0*(double)(statReturnMispred)/(double)(statReturn ? statReturn : 1));
+    printf("\nRAS_OVERFLOWS        \t : %10llu",   ras->GetNumOverflows());
+    printf("\nRAS_EMPTY_ON_RETURN  \t : %10llu",   statRasEmpty);
+    if(rasWrongPath != RAS_WRONG_PATH_OFF){
+      printf("\nRAS_WRONG_PATHS      \t : %10llu",   statRasWrongPath);
+    }
+  }
+
+}
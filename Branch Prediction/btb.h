@@ -0,0 +1,98 @@
+#ifndef _BTB_H_
+#define _BTB_H_
+
+#include "utils.h"
+#include "tracer.h"
+#include "ras.h"
+
+/////////////////////////////////////////////////////////////
+// Target prediction for taken branches. Direct branches and calls look
+// up a set-associative BTB with LRU replacement. Indirect branches and
+// calls first use a target cache indexed by the PC XOR a path history
+// of recent branch targets, and fall back to the BTB while the target
+// cache has no entry for them. Returns pop a RETURN_STACK, or use the
+// BTB when there is none or it is empty.
+//
+// Return accuracy comes from the calls and returns of the trace alone.
+// The trace holds no wrong path; RAS_WRONG_PATH_REPAIR or _NOREPAIR
+// make one up after each direction misprediction (see WrongPath) to
+// study speculative RAS damage, at the cost of return stats that depend
+// on the direction predictor.
+/////////////////////////////////////////////////////////////
+
+#define DEFAULT_BTB_LOG_SETS      9
+#define DEFAULT_BTB_WAYS          4
+#define DEFAULT_ITC_LOG_ENTRIES   10
+
+#define MAX_BTB_WAYS              64
+
+#define ITC_PATH_SHIFT            3       // path history bits per taken branch
+
+#define RAS_WRONG_PATH_OFF        0
+#define RAS_WRONG_PATH_REPAIR     1       // restored from a checkpoint
+#define RAS_WRONG_PATH_NOREPAIR   2
+
+typedef struct {
+  UINT32  PC;
+  UINT32  target;
+  UINT64  lastUse;        // 0: invalid
+} BTB_ENTRY;
+
+class TARGET_PREDICTOR{
+
+ private:
+  BTB_ENTRY *btb;         // sets of btbWays entries
+  UINT32  btbSetMask;
+  UINT32  btbWays;
+  UINT64  useClock;
+
+  UINT32 *targetCache;    // indirect targets, 0: no entry
+  UINT32  itcMask;
+  UINT32  pathHist;
+
+  RETURN_STACK *ras;      // NULL: returns use the BTB
+  UINT32  rasWrongPath;   // RAS_WRONG_PATH_*
+
+  // stats
+  UINT64  statTaken;          // taken branches that needed a target
+  UINT64  statBtbMiss;        // ... with no BTB entry
+  UINT64  statBtbWrong;       // ... with a stale BTB target
+  UINT64  statIndirect;
+  UINT64  statIndirectMispred;
+  UINT64  statReturn;
+  UINT64  statReturnMispred;
+  UINT64  statRasEmpty;       // returns that found the RAS empty
+  UINT64  statRasWrongPath;   // synthetic wrong paths (WrongPath)
+
+ public:
+  TARGET_PREDICTOR(UINT32 btbLogSets, UINT32 ways, UINT32 itcLogEntries,
+		   UINT32 rasDepth, UINT32 rasPolicy, UINT32 wrongPath);
+  ~TARGET_PREDICTOR();
+
+  // returns true if the target of the branch was predicted correctly;
+  // dirMispred tells whether a conditional branch was mispredicted
+  bool    Process(const CBP_TRACE_RECORD *rec, bool dirMispred){
+    if(rec->opType < OPTYPE_CALL_DIRECT || rec->opType >= OPTYPE_MAX){
+      return true;  // not a branch
+    }
+    return ProcessBranch(rec, dirMispred);
+  }
+
+  UINT64  GetNumTargetMispred(){
+    return statBtbMiss + statBtbWrong + statIndirectMispred + statReturnMispred;
+  }
+  void    ResetStats();
+  void    PrintStats(UINT64 numInst);
+
+ private:
+  bool    ProcessBranch(const CBP_TRACE_RECORD *rec, bool dirMispred);
+  bool    PredictDirect(const CBP_TRACE_RECORD *rec);
+  bool    PredictReturn(const CBP_TRACE_RECORD *rec);
+  void    WrongPath(UINT32 PC);
+  bool    LookupBTB(UINT32 PC, UINT32 *target);
+  void    UpdateBTB(UINT32 PC, UINT32 target);
+};
+
+
+/***********************************************************/
+#endif
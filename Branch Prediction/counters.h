@@ -0,0 +1,114 @@
+#ifndef _COUNTERS_H_
+#define _COUNTERS_H_
+
+#include <stdlib.h>
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// Table of n-bit saturating counters packed into 64 bit words. Each
+// counter gets a slot of 1, 2, 4 or 8 bits (the counter width rounded up
+// to a power of two) so a counter never straddles two words. A counter
+// predicts taken when it is in the upper half of its range. The words
+// start on a 64 byte boundary, so GetLine numbers real cache lines.
+/////////////////////////////////////////////////////////////
+
+#define COUNTER_MAX_BITS  8
+
+class COUNTER_TABLE{
+
+ private:
+  UINT64  *words;
+  UINT32  numEntries;
+  UINT32  ctrBits;       // bits of state per counter
+  UINT32  ctrMax;
+  UINT32  slotLog;       // log2 of the bits reserved per counter
+  UINT32  slotsLog;      // log2 of the counters held by one word
+  UINT32  slotMask;
+
+ public:
+  COUNTER_TABLE(UINT32 entries, UINT32 bits, UINT32 init);
+  ~COUNTER_TABLE(){ free(words); }
+
+  UINT32  Get(UINT32 index);
+  void    Set(UINT32 index, UINT32 value);
+  bool    IsTaken(UINT32 index){ return Get(index) > (ctrMax >> 1); }
+  bool    PredictAndUpdate(UINT32 index, bool resolveDir);
+
+  UINT32  GetLine(UINT32 index){ return index >> (slotsLog+3); }  // 64 byte line
+  UINT32  GetNumEntries(){ return numEntries; }
+  UINT32  GetCtrMax(){ return ctrMax; }
+  UINT64  GetNumBytes(){ return 8*(((UINT64)numEntries + (1<<slotsLog) - 1) >> slotsLog); }
+};
+
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+inline COUNTER_TABLE::COUNTER_TABLE(UINT32 entries, UINT32 bits, UINT32 init){
+
+  if(bits == 0 || bits > COUNTER_MAX_BITS || init > (1u<<bits)-1){
+    printf("Invalid %u bit counter table (init %u)\n", bits, init);
+    exit(-1);
+  }
+
+  numEntries = entries;
+  ctrBits    = bits;
+  ctrMax     = (1<<bits)-1;
+
+  slotLog = 0;
+  while((1u<<slotLog) < bits){
+    slotLog++;
+  }
+  slotsLog = 6-slotLog;
+  slotMask = (1u<<(1<<slotLog))-1;
+
+  // replicate the initial value into every slot of a word
+  UINT64 pattern = 0;
+  for(UINT32 ii=0; ii< (1u<<slotsLog); ii++){
+    pattern |= (UINT64)init << (ii<<slotLog);
+  }
+
+  UINT64 numWords = GetNumBytes()/8;
+  if(posix_memalign((void **)&words, 64, numWords*8) != 0){
+    printf("Unable to allocate a %u entry counter table\n", entries);
+    exit(-1);
+  }
+  for(UINT64 ii=0; ii< numWords; ii++){
+    words[ii]=pattern;
+  }
+
+}
+
+inline UINT32 COUNTER_TABLE::Get(UINT32 index){
+  UINT32 shift = (index & ((1<<slotsLog)-1)) << slotLog;
+  return (words[index >> slotsLog] >> shift) & slotMask;
+}
+
+inline void COUNTER_TABLE::Set(UINT32 index, UINT32 value){
+  UINT64 *word  = &words[index >> slotsLog];
+  UINT32  shift = (index & ((1<<slotsLog)-1)) << slotLog;
+  *word = (*word & ~((UINT64)slotMask << shift)) | ((UINT64)value << shift);
+}
+
+/////////////////////////////////////////////////////////////
+// Returns the prediction of the counter, then moves it one step toward
+// the resolved direction. The word is read and written once.
+/////////////////////////////////////////////////////////////
+
+inline bool COUNTER_TABLE::PredictAndUpdate(UINT32 index, bool resolveDir){
+  UINT32  max   = ctrMax;  // locals: the store below may alias the members
+  UINT64 *word  = &words[index >> slotsLog];
+  UINT32  shift = (index & ((1<<slotsLog)-1)) << slotLog;
+  UINT64  value = *word;
+  UINT32  ctr   = (value >> shift) & slotMask;
+
+  // branch free saturating step: +1 below max if taken, -1 above 0 if not
+  UINT64  step  = resolveDir ? (UINT64)(ctr < max) : -(UINT64)(ctr > 0);
+
+  *word = value + (step << shift);
+  return ctr > (max >> 1);
+}
+
+
+/***********************************************************/
+#endif
@@ -0,0 +1,100 @@
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// Global branch history of any length, one bit per outcome in a
+// circular buffer of 64 bit words. Pushing a new outcome never shifts
+// the older ones. Bit(0) is the newest outcome.
+/////////////////////////////////////////////////////////////
+
+class GLOBAL_HISTORY{
+
+ private:
+  UINT64  *words;
+  UINT32  mask;          // bits in the buffer - 1
+  UINT32  head;          // position of the newest outcome
+
+ public:
+  GLOBAL_HISTORY(UINT32 maxLength);
+  ~GLOBAL_HISTORY(){ delete [] words; }
+
+  void    Push(bool resolveDir);
+  UINT32  Bit(UINT32 age){
+    UINT32 pos = (head+age) & mask;
+    return (words[pos >> 6] >> (pos & 63)) & 1;
+  }
+};
+
+inline GLOBAL_HISTORY::GLOBAL_HISTORY(UINT32 maxLength){
+  UINT32 size = 64;
+
+  // one spare bit: a folded view needs the bit that just left it
+  while(size < maxLength+1){
+    size <<= 1;
+  }
+
+  words = new UINT64[size/64];
+  for(UINT32 ii=0; ii< size/64; ii++){
+    words[ii]=0;
+  }
+  mask = size-1;
+  head = 0;
+}
+
+inline void GLOBAL_HISTORY::Push(bool resolveDir){
+  head = (head-1) & mask;
+
+  UINT64 *word = &words[head >> 6];
+  UINT32  bit  = head & 63;
+  *word = (*word & ~(1ull << bit)) | ((UINT64)resolveDir << bit);
+}
+
+
+/////////////////////////////////////////////////////////////
+// The newest origLength bits of a GLOBAL_HISTORY XOR-folded down to
+// compLength bits. Update() must be called after every Push() and costs
+// O(1) whatever origLength is. With origLength <= compLength nothing is
+// folded, Get() is the plain history with the newest outcome in bit 0,
+// and Update() never reads hist (it may be NULL).
+/////////////////////////////////////////////////////////////
+
+class FOLDED_HISTORY{
+
+ private:
+  UINT32  comp;
+  UINT32  compLength;
+  UINT32  origLength;
+  UINT32  outPoint;      // where the bit leaving the window lands
+  UINT32  compMask;
+
+ public:
+  FOLDED_HISTORY(){ Init(0, 1); }
+
+  void    Init(UINT32 orig, UINT32 compLen){
+    comp       = 0;
+    origLength = orig;
+    compLength = compLen;
+    outPoint   = orig % compLen;
+    compMask   = (1<<(orig < compLen ? orig : compLen))-1;
+  }
+
+  void    Update(bool resolveDir, GLOBAL_HISTORY *hist){
+    comp = (comp << 1) | resolveDir;
+
+    // a window that fits needs no fold, the mask drops its oldest bit
+    if(origLength > compLength){
+      comp ^= hist->Bit(origLength) << outPoint;
+      comp ^= comp >> compLength;
+    }
+    comp &= compMask;
+  }
+
+  bool    NeedsHistory(){ return origLength > compLength; }
+  UINT32  Get(){ return comp; }
+};
+
+
+/***********************************************************/
+#endif
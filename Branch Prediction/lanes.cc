@@ -0,0 +1,203 @@
+#include <string.h>
+#include "lanes.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+// PHT index width, as PREDICTOR sizes the gshare PHT
+static UINT32 GshareIndexBits(const PREDICTOR_CONFIG &cfg){
+  UINT32 indexBits = cfg.histLen;
+
+  if(indexBits > cfg.logTableEntries){
+    indexBits = cfg.logTableEntries;
+  }
+  if(cfg.pcBits > indexBits){
+    indexBits = cfg.pcBits;
+  }
+  return indexBits;
+}
+
+bool  LANE_PREDICTORS::CanRun(const PREDICTOR_CONFIG &cfg){
+  if(cfg.type == PRED_TYPE_TWOBIT_COUNTER){
+    return true;
+  }
+  // a history longer than the index would have to be folded
+  return cfg.type == PRED_TYPE_GSHARE && cfg.histLen <= GshareIndexBits(cfg);
+}
+
+UINT32  LANE_PREDICTORS::GetTableBytes(const PREDICTOR_CONFIG &cfg){
+  if(cfg.type == PRED_TYPE_GSHARE){
+    return 1u<<GshareIndexBits(cfg);
+  }
+  return 1u<<cfg.logTableEntries;
+}
+
+LANE_PREDICTORS::LANE_PREDICTORS(const PREDICTOR_CONFIG *configs, UINT32 numConfigs){
+
+  if(numConfigs == 0 || numConfigs > MAX_LANES){
+    printf("Lanes need 1 to %d configurations, not %u\n", MAX_LANES, numConfigs);
+    exit(-1);
+  }
+
+  numLanes  = numConfigs;
+  numPadded = (numLanes + LANE_VECTOR-1) / LANE_VECTOR * LANE_VECTOR;
+  numBytes  = 0;
+  GHR       = 0;
+
+  for(UINT32 ll=0; ll< numLanes; ll++){
+    const PREDICTOR_CONFIG &cfg = configs[ll];
+    UINT32 tableBytes = GetTableBytes(cfg);
+
+    if(!CanRun(cfg)){
+      printf("%s lane %u can not run in lanes\n", PredTypeName(cfg.type), ll);
+      exit(-1);
+    }
+    if(tableBytes > LANE_MAX_BYTES - numBytes){
+      printf("Lane tables exceed %u bytes\n", LANE_MAX_BYTES);
+      exit(-1);
+    }
+
+    laneBase[ll]  = numBytes;
+    indexMask[ll] = tableBytes-1;
+    ctrMax[ll]    = (1<<cfg.ctrBits)-1;
+    ctrHalf[ll]   = ctrMax[ll] >> 1;
+
+    if(cfg.type == PRED_TYPE_GSHARE){
+      pcMask[ll]   = (1<<cfg.pcBits)-1;
+      histMask[ll] = (1<<cfg.histLen)-1;
+    }else{
+      pcMask[ll]   = indexMask[ll];
+      histMask[ll] = 0;
+    }
+    numBytes += tableBytes;
+  }
+
+  for(UINT32 ll=numLanes; ll< numPadded; ll++){
+    laneBase[ll]  = numBytes;
+    pcMask[ll]    = 0;
+    histMask[ll]  = 0;
+    indexMask[ll] = 0;
+    ctrMax[ll]    = 0;
+    ctrHalf[ll]   = 0;
+  }
+
+  // the scratch byte, then room for a 32 bit gather of the last byte
+  counters = new UINT8[numBytes+4];
+  for(UINT32 ll=0; ll< numLanes; ll++){
+    UINT8 init = (configs[ll].type == PRED_TYPE_GSHARE) ? 1<<(configs[ll].ctrBits-1) : 0;
+    memset(counters+laneBase[ll], init, indexMask[ll]+1);
+  }
+  memset(counters+numBytes, 0, 4);
+
+  for(UINT32 ll=0; ll< MAX_LANES; ll++){
+    numMispred[ll] = 0;
+  }
+}
+
+/////////////////////////////////////////////////////////////
+// The records in blocks short enough for 32 bit per lane counts
+/////////////////////////////////////////////////////////////
+
+void  LANE_PREDICTORS::Simulate(const COND_TRACE_RECORD *rec, UINT64 numRecords){
+  alignas(32) UINT32 laneMispred[MAX_LANES];
+
+  for(UINT64 done=0; done< numRecords; ){
+    UINT32 block = (numRecords-done < LANE_FLUSH_RECORDS) ? numRecords-done : LANE_FLUSH_RECORDS;
+
+    for(UINT32 ll=0; ll< numPadded; ll++){
+      laneMispred[ll] = 0;
+    }
+    SimulateBlock(rec+done, block, laneMispred);
+    for(UINT32 ll=0; ll< numLanes; ll++){
+      numMispred[ll] += laneMispred[ll];
+    }
+    done += block;
+  }
+}
+
+/////////////////////////////////////////////////////////////
+// One record: every lane looks up its counter, counts a misprediction
+// if the counter disagrees with the outcome, and steps it toward the
+// outcome. Lanes own disjoint tables, so the stores never collide.
+/////////////////////////////////////////////////////////////
+
+#if defined(__AVX2__)
+
+void  LANE_PREDICTORS::SimulateBlock(const COND_TRACE_RECORD *rec, UINT32 numRecords,
+				     UINT32 *laneMispred){
+  alignas(32) UINT32 index[LANE_VECTOR];
+  alignas(32) UINT32 update[LANE_VECTOR];
+  __m256i byteMask = _mm256_set1_epi32(0xff);
+  __m256i zero     = _mm256_setzero_si256();
+
+  for(UINT32 ii=0; ii< numRecords; ii++){
+    bool    resolveDir = rec[ii].gapDir & 1;
+    __m256i pcv  = _mm256_set1_epi32(rec[ii].PC);
+    __m256i ghv  = _mm256_set1_epi32(GHR);
+    __m256i dirv = _mm256_set1_epi32(resolveDir ? -1 : 0);
+
+    for(UINT32 ll=0; ll< numPadded; ll+=LANE_VECTOR){
+      __m256i iv = _mm256_xor_si256(_mm256_and_si256(pcv, _mm256_loadu_si256((const __m256i *)(pcMask+ll))),
+				    _mm256_and_si256(ghv, _mm256_loadu_si256((const __m256i *)(histMask+ll))));
+      iv = _mm256_and_si256(iv, _mm256_loadu_si256((const __m256i *)(indexMask+ll)));
+      iv = _mm256_add_epi32(iv, _mm256_loadu_si256((const __m256i *)(laneBase+ll)));
+
+      __m256i cv   = _mm256_and_si256(_mm256_i32gather_epi32((const int *)counters, iv, 1), byteMask);
+      __m256i maxv = _mm256_loadu_si256((const __m256i *)(ctrMax+ll));
+      __m256i taken = _mm256_cmpgt_epi32(cv, _mm256_loadu_si256((const __m256i *)(ctrHalf+ll)));
+
+      // mispredicted lanes are -1
+      __m256i acc = _mm256_load_si256((const __m256i *)(laneMispred+ll));
+      acc = _mm256_sub_epi32(acc, _mm256_xor_si256(taken, dirv));
+      _mm256_store_si256((__m256i *)(laneMispred+ll), acc);
+
+      // -1 where the counter steps up, resp. down
+      __m256i up   = _mm256_and_si256(_mm256_cmpgt_epi32(maxv, cv), dirv);
+      __m256i down = _mm256_andnot_si256(dirv, _mm256_cmpgt_epi32(cv, zero));
+      cv = _mm256_add_epi32(_mm256_sub_epi32(cv, up), down);
+
+      _mm256_store_si256((__m256i *)index, iv);
+      _mm256_store_si256((__m256i *)update, cv);
+      for(UINT32 kk=0; kk< LANE_VECTOR; kk++){
+	counters[index[kk]] = update[kk];
+      }
+    }
+
+    GHR = (GHR << 1) | resolveDir;
+  }
+}
+
+const char *LaneSimdName(){ return "AVX2"; }
+
+#else
+
+void  LANE_PREDICTORS::SimulateBlock(const COND_TRACE_RECORD *rec, UINT32 numRecords,
+				     UINT32 *laneMispred){
+
+  for(UINT32 ii=0; ii< numRecords; ii++){
+    bool   resolveDir = rec[ii].gapDir & 1;
+    UINT32 PC         = rec[ii].PC;
+
+    for(UINT32 ll=0; ll< numLanes; ll++){
+      UINT32 index = laneBase[ll] + (((PC & pcMask[ll]) ^ (GHR & histMask[ll])) & indexMask[ll]);
+      UINT32 ctr   = counters[index];
+
+      laneMispred[ll] += (ctr > ctrHalf[ll]) != resolveDir;
+      if(resolveDir){
+	counters[index] = ctr + (ctr < ctrMax[ll]);
+      }else{
+	counters[index] = ctr - (ctr > 0);
+      }
+    }
+
+    GHR = (GHR << 1) | resolveDir;
+  }
+}
+
+const char *LaneSimdName(){ return "scalar"; }
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef _LANES_H_
+#define _LANES_H_
+
+#include "utils.h"
+#include "tracer.h"
+#include "predictor.h"
+
+/////////////////////////////////////////////////////////////
+// Up to MAX_LANES bimodal (TWOBIT_COUNTER) and gshare configurations
+// simulated side by side, one lane each. Every lane indexes its own
+// counter table with
+//
+//   base + (((PC & pcMask) ^ (GHR & histMask)) & indexMask)
+//
+// (histMask 0 for bimodal), so one record computes all the indices,
+// predictions and mispredictions with a few vector instructions and
+// the per-record work of a sweep is paid once rather than per
+// configuration. Counters are one byte each; the tables sit back to
+// back in one array. AVX2 gathers the counters when the compiler
+// targets it (e.g. -mavx2), a scalar loop runs otherwise, and the
+// updated counters are stored one lane at a time (no scatter in AVX2).
+//
+// The GHR is shared by all lanes, so a gshare lane must not fold its
+// history: histLen may not exceed the index width or 32 (CanRun).
+// Results are identical to PREDICTOR::SimulateBranches.
+/////////////////////////////////////////////////////////////
+
+#define MAX_LANES         64
+#define LANE_VECTOR       8       // lanes per AVX2 vector
+#define LANE_MAX_BYTES    (1u<<30)   // counters of all lanes together
+#define LANE_FLUSH_RECORDS (1u<<30)  // records per 32 bit mispredict count
+
+class LANE_PREDICTORS{
+
+ private:
+  UINT32  numLanes;
+  UINT32  numPadded;      // numLanes rounded up to LANE_VECTOR
+
+  UINT8  *counters;       // every lane's table, then one scratch byte
+  UINT32  numBytes;
+
+  // per lane parameters; padding lanes hit the scratch byte
+  UINT32  laneBase[MAX_LANES];
+  UINT32  pcMask[MAX_LANES];
+  UINT32  histMask[MAX_LANES];
+  UINT32  indexMask[MAX_LANES];
+  UINT32  ctrMax[MAX_LANES];
+  UINT32  ctrHalf[MAX_LANES];   // taken above ctrMax/2
+
+  UINT32  GHR;            // newest outcome in bit 0
+  UINT64  numMispred[MAX_LANES];
+
+ public:
+  LANE_PREDICTORS(const PREDICTOR_CONFIG *configs, UINT32 numConfigs);
+  ~LANE_PREDICTORS(){ delete [] counters; }
+
+  static bool    CanRun(const PREDICTOR_CONFIG &cfg);
+  static UINT32  GetTableBytes(const PREDICTOR_CONFIG &cfg);
+
+  void    Simulate(const COND_TRACE_RECORD *rec, UINT64 numRecords);
+  UINT64  GetNumMispred(UINT32 lane){ return numMispred[lane]; }
+
+ private:
+  void    SimulateBlock(const COND_TRACE_RECORD *rec, UINT32 numRecords, UINT32 *laneMispred);
+};
+
+const char *LaneSimdName();
+
+
+/***********************************************************/
+#endif
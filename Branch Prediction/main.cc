@@ -1,62 +1,948 @@
 /////////////////////////////////////////////////////////////////////////////////
+// build: g++ -std=c++17 -O2 -pthread -o predictor main.cc predictor.cc tage.cc perceptron.cc btb.cc profile.cc stats.cc tracer.cc -lz
+//        (add -mavx2 for the AVX2 perceptron, SSE2 is the x86-64 default)
 /////////////////////////////////////////////////////////////////////////////////
 
+#include <string.h>
+#include <thread>
 #include "utils.h"
 #include "tracer.h"
 #include "predictor.h"
+#include "btb.h"
+#include "profile.h"
+#include "stats.h"
 
-UINT32 PRED_TYPE=0;   
+#define MAX_PREDICTORS 64
+#define DEFAULT_SEG_WARMUP  1000000
+#define MAX_SEGMENTS        256
 
+UINT32 PRED_TYPE=0;
 
-// usage: predictor <type> <trace>
+
+// usage: predictor [-option <value>] <type> <trace>
+//
+// <trace> is a gzip CBP trace, or a packed or conditional-branch-only
+// trace made by tracepack. A gzip trace is inflated and parsed by a read
+// ahead thread while the predictors run, if there is more than one core
+// (-readahead 0 reads it inline).
+//
+// <type> is a single predictor type, a comma separated list of types
+// (e.g. 0,3,4 or 3,3 for two identical instances), or "all". Every
+// listed predictor is driven from the same pass over the trace.
+//
+// Options set the predictor geometry (see PREDICTOR_CONFIG); they apply
+// to every listed predictor:
+//   -hist        <num>   global history bits of TWOLEVEL_PRED (default 16);
+//                        up to 4096 for GSHARE/TOURNAMENT, folded to the index
+//   -logentries  <num>   log2 entries of the PC indexed tables and the widest
+//                        GSHARE/TOURNAMENT history index (default 16)
+//   -ctrbits     <num>   counter width of TWOBIT_COUNTER and the PHT (default 2)
+//   -pcbits      <num>   PC bits in the GSHARE/GSELECT index (default 8)
+//   -tagetables, -tagelogentries, -tagetagbits, -tageminhist, -tagemaxhist
+//                        TAGE geometry; -logentries sizes its base table
+//   -perchist, -perclogrows, -perctables
+//                        perceptron history, log2 weight vectors per table
+//                        and tables, each weighing one history segment
+//   -bhtlogentries, -localhist
+//                        PAG/PAP branch history table and local history;
+//                        PAP also selects its pattern table with -pcbits
+//
+// Target prediction (BTB and indirect target cache) runs once beside the
+// direction predictors on traces that keep branch targets, i.e. not on
+// conditional-branch-only traces:
+//   -btblogsets  <num>   log2 BTB sets (default 9)
+//   -btbways     <num>   BTB associativity, 0 turns target prediction off (default 4)
+//   -itclogentries <num> log2 entries of the indirect target cache (default 10)
+//   -rasdepth    <num>   return address stack entries, 0 for none (default 16)
+//   -rasoverflow <wrap|drop>  push onto a full RAS overwrites the oldest
+//                        entry or is lost (default wrap)
+//   -raswrongpath <off|repair|norepair>  make up a wrong path (two
+//                        returns, one call) after every direction
+//                        misprediction, with or without restoring a RAS
+//                        checkpoint (default off). Return stats then depend
+//                        on the direction predictor; with several
+//                        predictors the first one drives the RAS
+//
+//   -profile     <num>   count executions, taken outcomes and mispredictions
+//                        per static branch (of the first predictor) and
+//                        print the <num> branches with most mispredictions
+//   -interval    <num>   write MPKI and accuracy of every predictor for each
+//                        <num> instructions to a CSV file
+//   -statsfile   <file>  the CSV file of -interval (default interval_stats.csv)
+//
+// Measurement can start part way into the trace:
+//   -skip        <num>   fast forward <num> instructions without
+//                        simulating them
+//   -warmup      <num>   then train the predictors on <num> instructions
+//                        without counting them
+// All reported stats cover only the instructions after both.
+//
+// A packed or chunked trace (tracepack -z) can be split into segments
+// simulated in parallel, each on its own thread with fresh predictors;
+// target prediction, -profile and -interval are not available:
+//   -segments    <num>   split the measured instructions into <num>
+//                        segments (default 1)
+//   -segwarmup   <num>   train each segment but the first on the <num>
+//                        instructions before it (default 1000000); the
+//                        first one is warmed by -warmup
+//
+// A single LAST_TIME or TWOBIT_COUNTER predictor, whose state is only PC
+// indexed, can split the conditional branches by table index across
+// threads with the same result; the trace is loaded into memory first.
+// Target prediction and the options above are not available:
+//   -pcthreads   <num>   threads of the partitioned replay (default 1)
+//
+// Sampling estimates the MPKI from short windows spread over the trace
+// and reports it with a 95% confidence interval. Target prediction is
+// not modelled, -profile and -interval are not available:
+//   -sample      <num>   measure windows of <num> instructions (default off)
+//   -sampleperiod <num>  one window every <num> instructions (default
+//                        trace length / 30 if the trace header has it,
+//                        else 100 windows)
+//   -sampleerror <pct>   stop once every predictor's interval is within
+//                        <pct> percent of its MPKI, tested every 10
+//                        windows; if a pass over the whole trace ends
+//                        first, halve the period and sample the windows in
+//                        between; 0 for one pass (default 2). A run that
+//                        stops part way through a pass has only sampled
+//                        the trace up to there, which can bias the
+//                        estimate if the trace has phases
+//   -samplewarm  <num|all>  fast forward the gaps, training only on the
+//                        <num> instructions before each window, or train
+//                        on the whole gap (default 10 windows)
+
+void DieUsage(char *prog){
+  printf("usage: %s [-option <value>] <type> <trace>\n", prog);
+  printf("       <type> may be a list such as 0,3,4 or \"all\"\n");
+  printf("   Options\n");
+  printf("      -hist        <num>   Global history length in bits (Default: %d)\n", DEFAULT_HIST_LEN);
+  printf("      -logentries  <num>   Log2 entries of PC indexed tables (Default: %d)\n", DEFAULT_LOG_TABLE_ENTRIES);
+  printf("      -ctrbits     <num>   Saturating counter width in bits (Default: %d)\n", DEFAULT_CTR_BITS);
+  printf("      -pcbits      <num>   PC bits hashed into the gshare/gselect index (Default: %d)\n", DEFAULT_PC_BITS);
+  printf("      -tagetables  <num>   TAGE tagged tables (Default: %d)\n", DEFAULT_TAGE_TABLES);
+  printf("      -tagelogentries <num> Log2 entries per TAGE tagged table (Default: %d)\n", DEFAULT_TAGE_LOG_ENTRIES);
+  printf("      -tagetagbits <num>   TAGE tag width in bits (Default: %d)\n", DEFAULT_TAGE_TAG_BITS);
+  printf("      -tageminhist <num>   History of the shortest TAGE table (Default: %d)\n", DEFAULT_TAGE_MIN_HIST);
+  printf("      -tagemaxhist <num>   History of the longest TAGE table (Default: %d)\n", DEFAULT_TAGE_MAX_HIST);
+  printf("      -perchist    <num>   Perceptron history length (Default: %d, %s)\n", DEFAULT_PERC_HIST,
+	 PerceptronSimdName());
+  printf("      -perclogrows <num>   Log2 weight vectors per perceptron table (Default: %d)\n", DEFAULT_PERC_LOG_ROWS);
+  printf("      -perctables  <num>   Perceptron tables, one per history segment (Default: %d)\n", DEFAULT_PERC_TABLES);
+  printf("      -bhtlogentries <num> Log2 local history registers of PAG/PAP (Default: %d)\n", DEFAULT_BHT_LOG_ENTRIES);
+  printf("      -localhist   <num>   PAG/PAP local history length (Default: %d)\n", DEFAULT_LOCAL_HIST_LEN);
+  printf("      -btblogsets  <num>   Log2 BTB sets (Default: %d)\n", DEFAULT_BTB_LOG_SETS);
+  printf("      -btbways     <num>   BTB ways, 0 for no target prediction (Default: %d)\n", DEFAULT_BTB_WAYS);
+  printf("      -itclogentries <num> Log2 indirect target cache entries (Default: %d)\n", DEFAULT_ITC_LOG_ENTRIES);
+  printf("      -rasdepth    <num>   Return address stack entries, 0 for none (Default: %d)\n", DEFAULT_RAS_DEPTH);
+  printf("      -rasoverflow <wrap|drop> Full RAS overwrites the oldest entry or drops the push (Default: wrap)\n");
+  printf("      -raswrongpath <off|repair|norepair> Synthetic wrong path after each misprediction (Default: off)\n");
+  printf("      -profile     <num>   Print the <num> most mispredicted branches (Default: off)\n");
+  printf("      -interval    <num>   Stats for every <num> instructions to a CSV file (Default: off)\n");
+  printf("      -statsfile   <file>  CSV file of -interval (Default: %s)\n", DEFAULT_STATS_FILE);
+  printf("      -readahead   <0|1>   Read a gzip trace on a separate thread (Default: 1)\n");
+  printf("      -traceserver <socket> Map the trace decoded by traceserver (Default: off)\n");
+  printf("      -skip        <num>   Fast forward <num> instructions (Default: 0)\n");
+  printf("      -warmup      <num>   Train on <num> instructions before measuring (Default: 0)\n");
+  printf("      -segments    <num>   Simulate <num> segments in parallel (Default: 1)\n");
+  printf("      -segwarmup   <num>   Instructions that warm each segment (Default: %d)\n", DEFAULT_SEG_WARMUP);
+  printf("      -pcthreads   <num>   Partitioned replay of LAST_TIME/TWOBIT_COUNTER (Default: 1)\n");
+  printf("      -sample      <num>   Sampled MPKI from windows of <num> instructions (Default: off)\n");
+  printf("      -sampleperiod <num>  Instructions from one window to the next (Default: %d windows,\n"
+	 "                           or %d over a trace of known length)\n",
+	 DEFAULT_SAMPLE_PERIODS, SAMPLE_MIN_WINDOWS);
+  printf("      -sampleerror <pct>   Stop at this relative error, even part way through the trace and\n"
+	 "                           so possibly biased; 0 for one pass (Default: %.1f)\n",
+	 DEFAULT_SAMPLE_ERROR);
+  printf("      -samplewarm  <num|all> Skip the gaps but <num> instructions, or train on all (Default: %d windows)\n",
+	 DEFAULT_SAMPLE_WARM_WINDOWS);
+  exit(-1);
+}
+
+UINT32 OptValue(int argc, char *argv[], int ii){
+  if(ii >= argc-1){
+    printf("Option %s needs a value\n", argv[ii]);
+    exit(-1);
+  }
+  return atoi(argv[ii+1]);
+}
+
+UINT32 ParsePredTypes(char *arg, UINT32 *types, char *prog){
+  UINT32 numTypes=0;
+
+  if(!strcmp(arg, "all")){
+    for(UINT32 ii=0; ii< PRED_TYPE_MAX; ii++){
+      types[numTypes++]=ii;
+    }
+    return numTypes;
+  }
+
+  for(char *tok=strtok(arg, ","); tok != NULL; tok=strtok(NULL, ",")){
+    if(numTypes == MAX_PREDICTORS){
+      printf("At most %d predictors can be run together\n", MAX_PREDICTORS);
+      exit(-1);
+    }
+    types[numTypes]=atoi(tok);
+    if(types[numTypes] >= PRED_TYPE_MAX){
+      printf("Undefined Predictor Type %s\n", tok);
+      exit(-1);
+    }
+    numTypes++;
+  }
+
+  if(numTypes == 0){
+    printf("No predictor types given\n");
+    DieUsage(prog);
+  }
+  return numTypes;
+}
+
+/////////////////////////////////////////////////////////////
+// Optional instrumentation driven from the simulation loops; a NULL
+// member is turned off
+/////////////////////////////////////////////////////////////
+
+typedef struct {
+  TARGET_PREDICTOR *targets;
+  BRANCH_PROFILE   *profile;
+  INTERVAL_STATS   *intervals;
+} SIM_HOOKS;
+
+/////////////////////////////////////////////////////////////
+// Simulation loop for a single predictor, instantiated once per type so
+// the per-branch type switch and the separate update call disappear.
+// Runs until the trace reaches endInst instructions or ends.
+/////////////////////////////////////////////////////////////
+
+template<UINT32 TYPE>
+UINT64 SimulateSingle(CBP_TRACER *tracer, PREDICTOR *brpred, const SIM_HOOKS &hooks,
+		      UINT64 endInst){
+  const CBP_TRACE_RECORD *trace;
+  UINT64 numMispred=0;
+
+  TARGET_PREDICTOR *targets   = hooks.targets;
+  BRANCH_PROFILE   *profile   = hooks.profile;
+  INTERVAL_STATS   *intervals = hooks.intervals;
+
+  while (tracer->GetNumInst() < endInst && (trace = tracer->NextRecord()) != NULL) {
+    bool mispred = false;
+
+    if(trace->opType == OPTYPE_BRANCH_COND){
+      bool predDir = brpred->PredictAndUpdate<TYPE>(trace->PC, trace->branchTaken);
+      mispred     = (predDir != trace->branchTaken);
+      numMispred += mispred;
+      if(profile != NULL){
+	profile->Record(trace->PC, trace->branchTaken, mispred);
+      }
+    }
+    if(targets != NULL){
+      targets->Process(trace, mispred);
+    }
+    if(intervals != NULL && intervals->Due(tracer->GetNumInst())){
+      intervals->Sample(tracer->GetNumInst(), tracer->GetNumCondBranch(), &numMispred);
+    }
+  }
+
+  return numMispred;
+}
+
+UINT64 SimulateSingle(CBP_TRACER *tracer, PREDICTOR *brpred, const SIM_HOOKS &hooks,
+		      UINT64 endInst){
+
+  switch(brpred->GetPredType()){
+  case PRED_TYPE_NEVERTAKEN:     return SimulateSingle<PRED_TYPE_NEVERTAKEN>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_ALWAYSTAKEN:    return SimulateSingle<PRED_TYPE_ALWAYSTAKEN>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_LAST_TIME:      return SimulateSingle<PRED_TYPE_LAST_TIME>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_TWOBIT_COUNTER: return SimulateSingle<PRED_TYPE_TWOBIT_COUNTER>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_TWOLEVEL_PRED:  return SimulateSingle<PRED_TYPE_TWOLEVEL_PRED>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_GSHARE:         return SimulateSingle<PRED_TYPE_GSHARE>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_GSELECT:        return SimulateSingle<PRED_TYPE_GSELECT>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_TOURNAMENT:     return SimulateSingle<PRED_TYPE_TOURNAMENT>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_TAGE:           return SimulateSingle<PRED_TYPE_TAGE>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_PERCEPTRON:     return SimulateSingle<PRED_TYPE_PERCEPTRON>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_PAG:            return SimulateSingle<PRED_TYPE_PAG>(tracer, brpred, hooks, endInst);
+  case PRED_TYPE_PAP:            return SimulateSingle<PRED_TYPE_PAP>(tracer, brpred, hooks, endInst);
+  default: printf("Undefined Predictor Type\n");
+           exit(-1);
+  }
+
+}
+
+/////////////////////////////////////////////////////////////
+// Simulation loop for several predictors driven by the same records,
+// up to endInst instructions; adds their mispredictions to numMispred.
+/////////////////////////////////////////////////////////////
+
+void SimulateMulti(CBP_TRACER *tracer, PREDICTOR **brpred, UINT32 numPreds,
+		   const SIM_HOOKS &hooks, UINT64 endInst, UINT64 *numMispred){
+  const CBP_TRACE_RECORD *trace;
+
+  TARGET_PREDICTOR *targets   = hooks.targets;
+  BRANCH_PROFILE   *profile   = hooks.profile;
+  INTERVAL_STATS   *intervals = hooks.intervals;
+
+  while (tracer->GetNumInst() < endInst && (trace = tracer->NextRecord()) != NULL) {
+
+    bool firstMispred = false;  // the RAS follows the first predictor
+
+    if(trace->opType == OPTYPE_BRANCH_COND){
+
+      for(UINT32 ii=0; ii< numPreds; ii++){
+
+	bool predDir = brpred[ii]->GetPrediction(trace->PC);
+
+	brpred[ii]->UpdatePredictor(trace->PC, trace->branchTaken,predDir);
+
+	if(predDir != trace->branchTaken){
+	  numMispred[ii]++; // update mispred stats
+	  firstMispred |= (ii == 0);
+	}
+
+      }
+
+      if(profile != NULL){
+	profile->Record(trace->PC, trace->branchTaken, firstMispred);
+      }
+
+    }
+
+    if(targets != NULL){
+      targets->Process(trace, firstMispred);
+    }
+    if(intervals != NULL && intervals->Due(tracer->GetNumInst())){
+      intervals->Sample(tracer->GetNumInst(), tracer->GetNumCondBranch(), numMispred);
+    }
+
+  }
+}
+
+void Simulate(CBP_TRACER *tracer, PREDICTOR **brpred, UINT32 numPreds,
+	      const SIM_HOOKS &hooks, UINT64 endInst, UINT64 *numMispred){
+  if(numPreds == 1){
+    numMispred[0] += SimulateSingle(tracer, brpred[0], hooks, endInst);
+  }else{
+    SimulateMulti(tracer, brpred, numPreds, hooks, endInst, numMispred);
+  }
+}
+
+/////////////////////////////////////////////////////////////
+// Sampled simulation. A pass over the trace measures a window of
+// windowLen instructions at the end of every period. All but the last
+// warmLen instructions of the gap before a window are fast forwarded
+// and the rest only train the predictors (functional warming); with
+// SAMPLE_WARM_ALL the whole gap trains them. A partial window at the end
+// of the trace is dropped.
+//
+// Convergence is tested every SAMPLE_CHECK_WINDOWS windows and the run
+// stops as soon as every predictor is within targetError percent, even
+// part way through a pass. Until then, another pass measures the windows
+// half way between those already measured, from a rewound or reopened
+// trace. Returns the number of passes and in traceInst the instructions
+// the passes reached.
+/////////////////////////////////////////////////////////////
+
+UINT32 SimulateSampled(char *traceName, CBP_TRACER *tracer, PREDICTOR **brpred, UINT32 numPreds,
+		       UINT64 windowLen, UINT64 samplePeriod, UINT64 warmLen,
+		       double targetError, SAMPLE_STATS *samples, UINT64 *traceInst){
+  SIM_HOOKS   noHooks = { NULL, NULL, NULL };
+  UINT64      windowMispred[MAX_PREDICTORS];
+  UINT64      startInst = tracer->GetNumInst();
+  CBP_TRACER *pass      = tracer;
+  UINT64      period    = samplePeriod;
+  UINT64      offset    = 0;        // from the end of a window to the end of its period
+  UINT32      numPasses = 0;
+  bool        converged = false;
+
+  *traceInst = 0;
+
+  while(!converged){
+    numPasses++;
+
+    for(UINT64 periodEnd=startInst+period; ; periodEnd+=period){
+      UINT64 windowEnd   = periodEnd - offset;
+      UINT64 windowStart = windowEnd - windowLen;
+
+      if(pass->GetNumInst() < windowStart && windowStart - pass->GetNumInst() > warmLen){
+	pass->Skip(windowStart - warmLen - pass->GetNumInst());
+      }
+      for(UINT32 ii=0; ii< numPreds; ii++){
+	windowMispred[ii] = 0;      // the gap only trains
+      }
+      Simulate(pass, brpred, numPreds, noHooks, windowStart, windowMispred);
+
+      UINT64 startWindowInst = pass->GetNumInst();
+      UINT64 startCondBranch = pass->GetNumCondBranch();
+
+      for(UINT32 ii=0; ii< numPreds; ii++){
+	windowMispred[ii] = 0;
+      }
+      Simulate(pass, brpred, numPreds, noHooks, windowEnd, windowMispred);
+
+      if(pass->GetNumInst() < windowEnd){
+	break;
+      }
+      samples->AddSample(pass->GetNumInst()-startWindowInst,
+			 pass->GetNumCondBranch()-startCondBranch, windowMispred);
+
+      // stopping here leaves the rest of the pass unsampled
+      if(samples->GetNumSamples() % SAMPLE_CHECK_WINDOWS == 0 && samples->Converged(targetError)){
+	converged = true;
+	break;
+      }
+    }
+
+    if(pass->GetNumInst() - startInst > *traceInst){
+      *traceInst = pass->GetNumInst() - startInst;
+    }
+    if(converged || samples->GetNumSamples() < 2 || targetError <= 0 || samples->Converged(targetError)){
+      break;
+    }
+
+    // the next windows end half way between the ends of these, unless
+    // they would overlap them
+    if(offset > 0){
+      period = offset;
+    }
+    offset = period/2;
+    if(offset < windowLen){
+      break;
+    }
+
+    if(pass->IsSeekable()){
+      pass->Seek(startInst);
+    }else{
+      if(pass != tracer){
+	delete pass;
+      }
+      pass = new CBP_TRACER(traceName, true);
+      pass->Skip(startInst);
+    }
+  }
+
+  if(pass != tracer){
+    delete pass;
+  }
+  return numPasses;
+}
+
+/////////////////////////////////////////////////////////////
+// Parallel segments: each worker seeks its own tracer to warmStart,
+// trains fresh predictors up to start and measures [start, end).
+/////////////////////////////////////////////////////////////
+
+typedef struct {
+  UINT64  warmStart;
+  UINT64  start;
+  UINT64  end;
+
+  UINT64  numInst;
+  UINT64  numCondBranch;
+  UINT64  numMispred[MAX_PREDICTORS];
+} SEGMENT;
+
+void SimulateSegment(char *traceName, PREDICTOR_CONFIG config, const UINT32 *predTypes,
+		     UINT32 numPreds, SEGMENT *seg){
+  CBP_TRACER *tracer = new CBP_TRACER(traceName);
+  PREDICTOR  *brpred[MAX_PREDICTORS];
+  SIM_HOOKS   noHooks = { NULL, NULL, NULL };
+
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    config.type = predTypes[ii];
+    brpred[ii]  = new PREDICTOR(config);
+  }
+
+  // the warm phase only trains
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    seg->numMispred[ii] = 0;
+  }
+  tracer->Seek(seg->warmStart);
+  Simulate(tracer, brpred, numPreds, noHooks, seg->start, seg->numMispred);
+
+  UINT64 startInst       = tracer->GetNumInst();
+  UINT64 startCondBranch = tracer->GetNumCondBranch();
+
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    seg->numMispred[ii] = 0;
+  }
+  Simulate(tracer, brpred, numPreds, noHooks, seg->end, seg->numMispred);
+
+  seg->numInst       = tracer->GetNumInst()-startInst;
+  seg->numCondBranch = tracer->GetNumCondBranch()-startCondBranch;
+
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    delete brpred[ii];
+  }
+  delete tracer;
+}
 
 int main(int argc, char* argv[]){
-  
-  if (argc != 3) {
-    printf("usage: %s <type> <trace>\n", argv[0]);
+
+  PREDICTOR_CONFIG config;
+  UINT32 btbLogSets=DEFAULT_BTB_LOG_SETS;
+  UINT32 btbWays=DEFAULT_BTB_WAYS;
+  UINT32 itcLogEntries=DEFAULT_ITC_LOG_ENTRIES;
+  UINT32 rasDepth=DEFAULT_RAS_DEPTH;
+  UINT32 rasPolicy=RAS_OVERFLOW_WRAP;
+  UINT32 rasWrongPath=RAS_WRONG_PATH_OFF;
+  UINT32 profileTop=0;
+  UINT64 intervalLen=0;
+  const char *statsFile=DEFAULT_STATS_FILE;
+  bool   readAhead=true;
+  UINT64 skipInst=0;
+  UINT64 warmupInst=0;
+  UINT32 numSegments=1;
+  UINT64 segWarmup=DEFAULT_SEG_WARMUP;
+  UINT32 pcThreads=1;
+  UINT64 sampleLen=0;
+  UINT64 samplePeriod=0;
+  double sampleError=DEFAULT_SAMPLE_ERROR;
+  bool   sampleWarmSet=false;
+  UINT64 sampleWarm=0;
+  char  *typeArg=NULL;
+  char  *traceName=NULL;
+
+  for(int ii=1; ii< argc; ii++){
+    if(argv[ii][0] == '-'){
+      if(!strcmp(argv[ii], "-h") || !strcmp(argv[ii], "-help")){
+	DieUsage(argv[0]);
+      }
+      else if(!strcmp(argv[ii], "-hist")){
+	config.histLen = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-logentries")){
+	config.logTableEntries = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-ctrbits")){
+	config.ctrBits = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-pcbits")){
+	config.pcBits = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-tagetables")){
+	config.tageTables = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-tagelogentries")){
+	config.tageLogEntries = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-tagetagbits")){
+	config.tageTagBits = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-tageminhist")){
+	config.tageMinHist = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-tagemaxhist")){
+	config.tageMaxHist = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-perchist")){
+	config.percHist = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-perclogrows")){
+	config.percLogRows = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-perctables")){
+	config.percTables = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-bhtlogentries")){
+	config.bhtLogEntries = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-localhist")){
+	config.localHistLen = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-btblogsets")){
+	btbLogSets = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-btbways")){
+	btbWays = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-itclogentries")){
+	itcLogEntries = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-rasdepth")){
+	rasDepth = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-rasoverflow")){
+	OptValue(argc, argv, ii);
+	if(!strcmp(argv[ii+1], "wrap")){
+	  rasPolicy = RAS_OVERFLOW_WRAP;
+	}else if(!strcmp(argv[ii+1], "drop")){
+	  rasPolicy = RAS_OVERFLOW_DROP;
+	}else{
+	  printf("Invalid RAS overflow policy %s\n", argv[ii+1]);
+	  DieUsage(argv[0]);
+	}
+	ii++;
+      }
+      else if(!strcmp(argv[ii], "-raswrongpath")){
+	OptValue(argc, argv, ii);
+	if(!strcmp(argv[ii+1], "off")){
+	  rasWrongPath = RAS_WRONG_PATH_OFF;
+	}else if(!strcmp(argv[ii+1], "repair")){
+	  rasWrongPath = RAS_WRONG_PATH_REPAIR;
+	}else if(!strcmp(argv[ii+1], "norepair")){
+	  rasWrongPath = RAS_WRONG_PATH_NOREPAIR;
+	}else{
+	  printf("Invalid RAS wrong path mode %s\n", argv[ii+1]);
+	  DieUsage(argv[0]);
+	}
+	ii++;
+      }
+      else if(!strcmp(argv[ii], "-profile")){
+	profileTop = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-interval")){
+	OptValue(argc, argv, ii);
+	intervalLen = strtoull(argv[++ii], NULL, 10);
+      }
+      else if(!strcmp(argv[ii], "-statsfile")){
+	OptValue(argc, argv, ii);
+	statsFile = argv[++ii];
+      }
+      else if(!strcmp(argv[ii], "-readahead")){
+	readAhead = OptValue(argc, argv, ii++) != 0;
+      }
+      else if(!strcmp(argv[ii], "-traceserver")){
+	OptValue(argc, argv, ii);
+	CBP_TRACER::SetTraceServer(argv[++ii]);
+      }
+      else if(!strcmp(argv[ii], "-skip")){
+	OptValue(argc, argv, ii);
+	skipInst = strtoull(argv[++ii], NULL, 10);
+      }
+      else if(!strcmp(argv[ii], "-warmup")){
+	OptValue(argc, argv, ii);
+	warmupInst = strtoull(argv[++ii], NULL, 10);
+      }
+      else if(!strcmp(argv[ii], "-segments")){
+	numSegments = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-segwarmup")){
+	OptValue(argc, argv, ii);
+	segWarmup = strtoull(argv[++ii], NULL, 10);
+      }
+      else if(!strcmp(argv[ii], "-pcthreads")){
+	pcThreads = OptValue(argc, argv, ii++);
+      }
+      else if(!strcmp(argv[ii], "-sample")){
+	OptValue(argc, argv, ii);
+	sampleLen = strtoull(argv[++ii], NULL, 10);
+      }
+      else if(!strcmp(argv[ii], "-sampleperiod")){
+	OptValue(argc, argv, ii);
+	samplePeriod = strtoull(argv[++ii], NULL, 10);
+      }
+      else if(!strcmp(argv[ii], "-sampleerror")){
+	OptValue(argc, argv, ii);
+	sampleError = atof(argv[++ii]);
+      }
+      else if(!strcmp(argv[ii], "-samplewarm")){
+	OptValue(argc, argv, ii);
+	sampleWarmSet = true;
+	sampleWarm    = !strcmp(argv[ii+1], "all") ? SAMPLE_WARM_ALL : strtoull(argv[ii+1], NULL, 10);
+	ii++;
+      }
+      else{
+	printf("Invalid option %s\n", argv[ii]);
+	DieUsage(argv[0]);
+      }
+    }
+    else if(typeArg == NULL){
+      typeArg = argv[ii];
+    }
+    else if(traceName == NULL){
+      traceName = argv[ii];
+    }
+    else{
+      DieUsage(argv[0]);
+    }
+  }
+
+  if (traceName == NULL) {
+    DieUsage(argv[0]);
+  }
+  if(btbLogSets > MAX_LOG_TABLE_ENTRIES || btbWays > MAX_BTB_WAYS ||
+     itcLogEntries > MAX_LOG_TABLE_ENTRIES){
+    printf("BTB and target cache can have 2^%d sets or entries and %d ways at most\n",
+	   MAX_LOG_TABLE_ENTRIES, MAX_BTB_WAYS);
+    exit(-1);
+  }
+  if(rasDepth > MAX_RAS_DEPTH){
+    printf("RAS can have at most %d entries\n", MAX_RAS_DEPTH);
+    exit(-1);
+  }
+  if(numSegments == 0 || numSegments > MAX_SEGMENTS){
+    printf("There can be 1 to %d segments\n", MAX_SEGMENTS);
+    exit(-1);
+  }
+  if(numSegments > 1 && (sampleLen > 0 || profileTop > 0 || intervalLen > 0)){
+    printf("-sample, -profile and -interval cannot be used with -segments\n");
+    exit(-1);
+  }
+  if(pcThreads > 1 && (numSegments > 1 || sampleLen > 0 || profileTop > 0 || intervalLen > 0 ||
+		       skipInst > 0 || warmupInst > 0)){
+    printf("-pcthreads cannot be used with -segments, -sample, -profile, -interval, -skip or -warmup\n");
     exit(-1);
   }
-  
+  if(sampleLen > 0){
+    if(samplePeriod != 0 && samplePeriod <= sampleLen){
+      printf("The sample period must be longer than the sample window\n");
+      exit(-1);
+    }
+    if(profileTop > 0 || intervalLen > 0){
+      printf("-profile and -interval cannot be used with -sample\n");
+      exit(-1);
+    }
+  }
+
   ///////////////////////////////////////////////
   // Init variables
   ///////////////////////////////////////////////
-    
-    PRED_TYPE  = atoi(argv[1]);
-    CBP_TRACER *tracer = new CBP_TRACER(argv[2]);
-    PREDICTOR  *brpred = new PREDICTOR();
-    CBP_TRACE_RECORD *trace = new CBP_TRACE_RECORD();
-    UINT64     numMispred =0;  
-    
+
+    UINT32     predTypes[MAX_PREDICTORS];
+    UINT32     numPreds = ParsePredTypes(typeArg, predTypes, argv[0]);
+    PRED_TYPE  = predTypes[0];
+
+    PREDICTOR  *brpred[MAX_PREDICTORS];
+    UINT64     numMispred[MAX_PREDICTORS];
+
+    for(UINT32 ii=0; ii< numPreds; ii++){
+      config.type    = predTypes[ii];
+      brpred[ii]     = new PREDICTOR(config);
+      numMispred[ii] = 0;
+    }
+
+    if(pcThreads > 1 && (numPreds != 1 || !brpred[0]->HasPcOnlyState())){
+      printf("-pcthreads needs a single LAST_TIME or TWOBIT_COUNTER predictor\n");
+      exit(-1);
+    }
+
+    // a partitioned replay loads the trace itself
+    CBP_TRACER *tracer = NULL;
+    if(pcThreads == 1){
+      tracer = new CBP_TRACER(traceName, readAhead);
+    }
+
+    SIM_HOOKS hooks;
+
+    const char *predNames[MAX_PREDICTORS];
+    for(UINT32 ii=0; ii< numPreds; ii++){
+      predNames[ii] = PredTypeName(predTypes[ii]);
+    }
+
+    hooks.targets = NULL;
+    if(btbWays > 0 && tracer != NULL && !tracer->IsCondOnly() && sampleLen == 0 &&
+       numSegments == 1){
+      hooks.targets = new TARGET_PREDICTOR(btbLogSets, btbWays, itcLogEntries,
+					   rasDepth, rasPolicy, rasWrongPath);
+    }
+
+    hooks.profile = (profileTop > 0) ? new BRANCH_PROFILE() : NULL;
+
+    hooks.intervals = NULL;
+    if(intervalLen > 0){
+      hooks.intervals = new INTERVAL_STATS(statsFile, intervalLen, numPreds, predNames);
+    }
+
+    TARGET_PREDICTOR *targets   = hooks.targets;
+    BRANCH_PROFILE   *profile   = hooks.profile;
+    INTERVAL_STATS   *intervals = hooks.intervals;
+
   ///////////////////////////////////////////////
-  // read each trace recod, simulate until done
+  // fast forward, warm up, then read each trace recod, simulate until done
   ///////////////////////////////////////////////
 
-      while (tracer->GetNextRecord(trace)) {
+    // with segments, this thread simulates the first one up to endInst
+    UINT64       endInst  = (UINT64)-1;
+    SEGMENT     *segments = NULL;
+    std::thread *workers  = NULL;
+
+    if(numSegments > 1){
+      if(!tracer->IsSeekable()){
+	printf("-segments needs a packed or chunked trace (see tracepack)\n");
+	exit(-1);
+      }
+
+      UINT64 traceInst   = tracer->GetTraceInst();
+      UINT64 regionStart = skipInst+warmupInst < traceInst ? skipInst+warmupInst : traceInst;
+      UINT64 regionLen   = traceInst-regionStart;
+
+      segments = new SEGMENT[numSegments];
+      workers  = new std::thread[numSegments];
+      endInst  = regionStart + regionLen/numSegments;
+
+      for(UINT32 ii=1; ii< numSegments; ii++){
+	SEGMENT *seg = &segments[ii];
+
+	seg->start     = regionStart + regionLen*ii/numSegments;
+	seg->end       = regionStart + regionLen*(ii+1)/numSegments;
+	seg->warmStart = (seg->start > skipInst + segWarmup) ? seg->start-segWarmup : skipInst;
+	workers[ii]    = std::thread(SimulateSegment, traceName, config, predTypes, numPreds, seg);
+      }
+    }
+
+    if(skipInst > 0){
+      tracer->Skip(skipInst);
+      skipInst = tracer->GetNumInst();
+    }
+
+    if(warmupInst > 0){
+      SIM_HOOKS warmHooks = hooks;  // train the target predictor, record nothing
+      warmHooks.profile   = NULL;
+      warmHooks.intervals = NULL;
+
+      Simulate(tracer, brpred, numPreds, warmHooks, skipInst+warmupInst, numMispred);
+      warmupInst = tracer->GetNumInst()-skipInst;
+
+      for(UINT32 ii=0; ii< numPreds; ii++){
+	numMispred[ii] = 0;
+	brpred[ii]->ResetStats();
+      }
+      if(targets != NULL){
+	targets->ResetStats();
+      }
+    }
+
+    UINT64 startInst       = (tracer != NULL) ? tracer->GetNumInst() : 0;
+    UINT64 startCondBranch = (tracer != NULL) ? tracer->GetNumCondBranch() : 0;
+
+    if(intervals != NULL){
+      intervals->Start(startInst, startCondBranch);
+    }
 
-	if(trace->opType == OPTYPE_BRANCH_COND){
+    if(sampleLen > 0){
+      SAMPLE_STATS *samples = new SAMPLE_STATS(numPreds);
 
-	  bool predDir = brpred->GetPrediction(trace->PC);
+      UINT64 traceInst = 0;
 
-	  brpred->UpdatePredictor(trace->PC, trace->branchTaken,predDir);
-	  
-	  if(predDir != trace->branchTaken){
-	    numMispred++; // update mispred stats
-	  }
-	  
+      // without a period, about SAMPLE_MIN_WINDOWS windows if the
+      // length of the trace is known
+      if(samplePeriod == 0){
+	samplePeriod = sampleLen*DEFAULT_SAMPLE_PERIODS;
+	if(tracer->GetTraceInst() > startInst){
+	  samplePeriod = (tracer->GetTraceInst()-startInst) / SAMPLE_MIN_WINDOWS;
 	}
-      
+	if(samplePeriod < 2*sampleLen){
+	  samplePeriod = 2*sampleLen;
+	}
+      }
+
+      if(!sampleWarmSet){
+	sampleWarm = sampleLen*DEFAULT_SAMPLE_WARM_WINDOWS;
       }
 
+      UINT32 numPasses = SimulateSampled(traceName, tracer, brpred, numPreds, sampleLen, samplePeriod,
+					 sampleWarm, sampleError, samples, &traceInst);
+
+      printf("\n");
+      printf("\nNUM_INSTRUCTIONS     \t : %10llu",   traceInst);
+      printf("\nNUM_SAMPLE_PASSES    \t : %10u",     numPasses);
+      printf("\nSAMPLE_PERIOD        \t : %10llu",   samplePeriod);
+      if(skipInst > 0){
+	printf("\nNUM_SKIPPED_INST     \t : %10llu",   skipInst);
+      }
+      if(warmupInst > 0){
+	printf("\nNUM_WARMUP_INST      \t : %10llu",   warmupInst);
+      }
+      if(samples->GetNumSamples() < 2){
+	printf("\nThe trace is too short for the sample period");
+      }
+      samples->PrintStats(predNames);
+      printf("\n\n");
+      delete samples;
+      return 0;
+    }
+
+    UINT64 numInst, numCondBranch;
+
+    if(pcThreads > 1){
+      COND_TRACE *condTrace = new COND_TRACE(traceName);
+
+      numMispred[0] = brpred[0]->SimulateBranchesPartitioned(condTrace->records,
+							     condTrace->numRecords, pcThreads);
+      numInst       = condTrace->numInst;
+      numCondBranch = condTrace->numRecords;
+      delete condTrace;
+    }else{
+      Simulate(tracer, brpred, numPreds, hooks, endInst, numMispred);
+      numInst       = tracer->GetNumInst()-startInst;
+      numCondBranch = tracer->GetNumCondBranch()-startCondBranch;
+    }
+
+    for(UINT32 ii=1; ii< numSegments; ii++){
+      workers[ii].join();
+      numInst       += segments[ii].numInst;
+      numCondBranch += segments[ii].numCondBranch;
+      for(UINT32 jj=0; jj< numPreds; jj++){
+	numMispred[jj] += segments[ii].numMispred[jj];
+      }
+    }
+    delete [] segments;
+    delete [] workers;
+
+    if(numInst == 0 && (skipInst > 0 || warmupInst > 0)){
+      printf("The trace ends within the skipped and warmup instructions\n");
+      exit(-1);
+    }
+
     ///////////////////////////////////////////
     //print_stats
     ///////////////////////////////////////////
 
+      if(intervals != NULL){
+	intervals->Finish(tracer->GetNumInst(), tracer->GetNumCondBranch(), numMispred);
+	delete intervals;
+      }
+
       printf("\n");
-      printf("\nNUM_INSTRUCTIONS     \t : %10llu",   tracer->GetNumInst());
-      printf("\nNUM_CONDITIONAL_BR   \t : %10llu",   tracer->GetNumCondBranch());
-      printf("\nNUM_MISPREDICTIONS   \t : %10llu",   numMispred);
-      printf("\nMISPRED_PER_1K_INST  \t : %10.3f",   1000.0*(double)(numMispred)/(double)(tracer->GetNumInst()));
-      printf("\nPERCENTAGE_CORRECT   \t : %10.3f",   100.0-100.0*(double)(numMispred)/(double)(tracer->GetNumCondBranch()));
+      printf("\nNUM_INSTRUCTIONS     \t : %10llu",   numInst);
+      printf("\nNUM_CONDITIONAL_BR   \t : %10llu",   numCondBranch);
+      if(skipInst > 0){
+	printf("\nNUM_SKIPPED_INST     \t : %10llu",   skipInst);
+      }
+      if(warmupInst > 0){
+	printf("\nNUM_WARMUP_INST      \t : %10llu",   warmupInst);
+      }
+
+      if(numPreds == 1){
+	printf("\nNUM_MISPREDICTIONS   \t : %10llu",   numMispred[0]);
+	printf("\nMISPRED_PER_1K_INST  \t : %10.3f",   1000.0*(double)(numMispred[0])/(double)(numInst));
+	printf("\nPERCENTAGE_CORRECT   \t : %10.3f",   100.0-100.0*(double)(numMispred[0])/(double)(numCondBranch));
+	if(targets != NULL){
+	  targets->PrintStats(numInst);
+	}
+	if(numSegments == 1){
+	  brpred[0]->PrintStats();  // would cover the first segment only
+	}
+	if(profile != NULL){
+	  profile->PrintTop(profileTop);
+	}
+	printf("\n\n");
+	return 0;
+      }
+
+      printf("\n\n%-3s %-16s %12s %12s %12s", "ID", "PREDICTOR",
+	     "MISPRED", "MPKI", "CORRECT(%)");
+      for(UINT32 ii=0; ii< numPreds; ii++){
+	printf("\n%-3u %-16s %12llu %12.3f %12.3f", ii, PredTypeName(predTypes[ii]),
+	       numMispred[ii],
+	       1000.0*(double)(numMispred[ii])/(double)(numInst),
+	       100.0-100.0*(double)(numMispred[ii])/(double)(numCondBranch));
+      }
+
+      if(targets != NULL){
+	printf("\n");
+	targets->PrintStats(numInst);
+      }
+
+      for(UINT32 ii=0; ii< numPreds; ii++){
+	if(brpred[ii]->HasStats() && numSegments == 1){
+	  printf("\n\n%-3u %s", ii, PredTypeName(predTypes[ii]));
+	  brpred[ii]->PrintStats();
+	}
+      }
+
+      if(profile != NULL){
+	printf("\n\n0   %s", PredTypeName(predTypes[0]));
+	profile->PrintTop(profileTop);
+      }
       printf("\n\n");
 }
 
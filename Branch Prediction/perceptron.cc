@@ -0,0 +1,223 @@
+#include "perceptron.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/////////////////////////////////////////////////////////////
+// Dot product and training over n weights, n a multiple of PERC_PAD.
+// History lanes are +1/-1, so the products fit the 16 bit multiply-add.
+/////////////////////////////////////////////////////////////
+
+#if defined(__AVX2__)
+
+static INT32 DotProduct(const INT16 *w, const INT16 *x, UINT32 n){
+  __m256i acc = _mm256_setzero_si256();
+
+  for(UINT32 ii=0; ii< n; ii+=16){
+    __m256i wv = _mm256_loadu_si256((const __m256i *)(w+ii));
+    __m256i xv = _mm256_loadu_si256((const __m256i *)(x+ii));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(wv, xv));
+  }
+
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+  return _mm_cvtsi128_si32(sum);
+}
+
+static void Train(INT16 *w, const INT16 *x, const INT16 *mask, UINT32 n, bool taken){
+  __m256i neg = _mm256_set1_epi16(taken ? 0 : -1);   // negate x when not taken
+  __m256i lo  = _mm256_set1_epi16(PERC_WEIGHT_MIN);
+  __m256i hi  = _mm256_set1_epi16(PERC_WEIGHT_MAX);
+
+  for(UINT32 ii=0; ii< n; ii+=16){
+    __m256i wv = _mm256_loadu_si256((const __m256i *)(w+ii));
+    __m256i xv = _mm256_loadu_si256((const __m256i *)(x+ii));
+    __m256i mv = _mm256_loadu_si256((const __m256i *)(mask+ii));
+    __m256i dv = _mm256_sub_epi16(_mm256_xor_si256(xv, neg), neg);
+    wv = _mm256_add_epi16(wv, _mm256_and_si256(dv, mv));
+    wv = _mm256_min_epi16(_mm256_max_epi16(wv, lo), hi);
+    _mm256_storeu_si256((__m256i *)(w+ii), wv);
+  }
+}
+
+const char *PerceptronSimdName(){ return "AVX2"; }
+
+#elif defined(__SSE2__)
+
+static INT32 DotProduct(const INT16 *w, const INT16 *x, UINT32 n){
+  __m128i acc = _mm_setzero_si128();
+
+  for(UINT32 ii=0; ii< n; ii+=8){
+    __m128i wv = _mm_loadu_si128((const __m128i *)(w+ii));
+    __m128i xv = _mm_loadu_si128((const __m128i *)(x+ii));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(wv, xv));
+  }
+
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4e));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xb1));
+  return _mm_cvtsi128_si32(acc);
+}
+
+static void Train(INT16 *w, const INT16 *x, const INT16 *mask, UINT32 n, bool taken){
+  __m128i neg = _mm_set1_epi16(taken ? 0 : -1);   // negate x when not taken
+  __m128i lo  = _mm_set1_epi16(PERC_WEIGHT_MIN);
+  __m128i hi  = _mm_set1_epi16(PERC_WEIGHT_MAX);
+
+  for(UINT32 ii=0; ii< n; ii+=8){
+    __m128i wv = _mm_loadu_si128((const __m128i *)(w+ii));
+    __m128i xv = _mm_loadu_si128((const __m128i *)(x+ii));
+    __m128i mv = _mm_loadu_si128((const __m128i *)(mask+ii));
+    __m128i dv = _mm_sub_epi16(_mm_xor_si128(xv, neg), neg);
+    wv = _mm_add_epi16(wv, _mm_and_si128(dv, mv));
+    wv = _mm_min_epi16(_mm_max_epi16(wv, lo), hi);
+    _mm_storeu_si128((__m128i *)(w+ii), wv);
+  }
+}
+
+const char *PerceptronSimdName(){ return "SSE2"; }
+
+#else
+
+static INT32 DotProduct(const INT16 *w, const INT16 *x, UINT32 n){
+  INT32 sum=0;
+
+  for(UINT32 ii=0; ii< n; ii++){
+    sum += w[ii]*x[ii];
+  }
+  return sum;
+}
+
+static void Train(INT16 *w, const INT16 *x, const INT16 *mask, UINT32 n, bool taken){
+  for(UINT32 ii=0; ii< n; ii++){
+    INT32 val = w[ii] + ((taken ? x[ii] : -x[ii]) & mask[ii]);
+    if(val > PERC_WEIGHT_MAX) val = PERC_WEIGHT_MAX;
+    if(val < PERC_WEIGHT_MIN) val = PERC_WEIGHT_MIN;
+    w[ii] = val;
+  }
+}
+
+const char *PerceptronSimdName(){ return "scalar"; }
+
+#endif
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+PERCEPTRON::PERCEPTRON(UINT32 tables, UINT32 logRows, UINT32 historyLength){
+
+  histLen   = historyLength;
+  numTables = tables;
+  rowMask   = (1<<logRows)-1;
+  theta     = (INT32)(1.93*histLen + 14);   // threshold from Jimenez and Lin
+
+  ghist  = new GLOBAL_HISTORY(histLen);
+  window = 0;
+
+  for(UINT32 tt=0; tt< numTables; tt++){
+    segStart[tt] = histLen*tt/numTables;
+    segLen[tt]   = histLen*(tt+1)/numTables - segStart[tt];
+    stride[tt]   = (segLen[tt] + PERC_PAD-1) & ~(PERC_PAD-1);
+    if(segStart[tt]+stride[tt] > window){
+      window = segStart[tt]+stride[tt];
+    }
+
+    weights[tt]  = new INT16[(rowMask+1)*stride[tt]];
+    laneMask[tt] = new INT16[stride[tt]];
+    for(UINT32 ii=0; ii< (rowMask+1)*stride[tt]; ii++){
+      weights[tt][ii]=0;
+    }
+    for(UINT32 ii=0; ii< stride[tt]; ii++){
+      laneMask[tt][ii] = (ii < segLen[tt]) ? -1 : 0;
+    }
+
+    // table 0 folds no history and is indexed by the PC alone
+    indexFold[tt].Init(segStart[tt], (logRows > 0) ? logRows : 1);
+  }
+
+  bias = new INT16[rowMask+1];
+  hist = new INT16[2*window];
+
+  for(UINT32 ii=0; ii<= rowMask; ii++){
+    bias[ii]=0;
+  }
+  for(UINT32 ii=0; ii< 2*window; ii++){
+    hist[ii] = -1;
+  }
+  head = 0;
+
+  biasRow = 0;
+  output  = 0;
+  for(UINT32 tt=0; tt< numTables; tt++){
+    row[tt] = 0;
+  }
+}
+
+PERCEPTRON::~PERCEPTRON(){
+  for(UINT32 tt=0; tt< numTables; tt++){
+    delete [] weights[tt];
+    delete [] laneMask[tt];
+  }
+  delete [] bias;
+  delete [] hist;
+  delete ghist;
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+bool   PERCEPTRON::GetPrediction(UINT32 PC){
+  UINT32 pcHash = PC ^ (PC >> 16);
+
+  biasRow = pcHash & rowMask;
+  output  = bias[biasRow];
+
+  for(UINT32 tt=0; tt< numTables; tt++){
+    row[tt] = (pcHash ^ indexFold[tt].Get()) & rowMask;
+    output += DotProduct(&weights[tt][row[tt]*stride[tt]], &hist[head+segStart[tt]], stride[tt]);
+  }
+
+  return output >= 0;
+}
+
+/////////////////////////////////////////////////////////////
+// Train on a mispredict or a low-confidence output, then shift the
+// outcome into the history. Padding lanes are masked so their weights
+// stay zero.
+/////////////////////////////////////////////////////////////
+
+void  PERCEPTRON::Update(UINT32 PC, bool resolveDir){
+  bool predDir = (output >= 0);
+
+  if(predDir != resolveDir || (output <= theta && output >= -theta)){
+    INT32 val = bias[biasRow] + (resolveDir ? 1 : -1);
+    if(val > PERC_WEIGHT_MAX) val = PERC_WEIGHT_MAX;
+    if(val < PERC_WEIGHT_MIN) val = PERC_WEIGHT_MIN;
+    bias[biasRow] = val;
+
+    for(UINT32 tt=0; tt< numTables; tt++){
+      Train(&weights[tt][row[tt]*stride[tt]], &hist[head+segStart[tt]], laneMask[tt],
+	    stride[tt], resolveDir);
+    }
+  }
+
+  head = (head == 0) ? window-1 : head-1;
+  hist[head]        = resolveDir ? 1 : -1;
+  hist[head+window] = hist[head];
+
+  ghist->Push(resolveDir);
+  for(UINT32 tt=0; tt< numTables; tt++){
+    indexFold[tt].Update(resolveDir, ghist);
+  }
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+UINT64 PERCEPTRON::GetStorageBytes(){
+  // the segments of a row hold histLen weights, plus the bias, PERC_WEIGHT_BITS each as modeled
+  return ((UINT64)(rowMask+1)*(histLen+1)*PERC_WEIGHT_BITS + 7)/8;
+}
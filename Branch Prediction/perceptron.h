@@ -0,0 +1,80 @@
+#ifndef _PERCEPTRON_H_
+#define _PERCEPTRON_H_
+
+#include "utils.h"
+#include "history.h"
+
+/////////////////////////////////////////////////////////////
+// Hashed perceptron predictor: the global history (+1 taken, -1 not
+// taken) is split into numTables segments of about equal length, and
+// each segment has its own table of signed weight vectors. Table t picks
+// its vector with the PC XOR the history newer than its segment, folded
+// to the row index, so older outcomes are weighed per path leading to
+// them. The prediction is the sign of a PC indexed bias plus the dot
+// products of every segment with its vector. With one table this is the
+// perceptron of Jimenez and Lin.
+//
+// Dot products and training use AVX2 or SSE2 when the compiler targets
+// them (e.g. -mavx2) and a scalar loop otherwise.
+/////////////////////////////////////////////////////////////
+
+#define MAX_PERC_HIST       1024
+#define MAX_PERC_LOG_ROWS   20
+#define MAX_PERC_TABLES     16
+
+#define PERC_WEIGHT_BITS    8       // weights saturate at 8 bit signed
+#define PERC_WEIGHT_MAX     127
+#define PERC_WEIGHT_MIN     (-128)
+#define PERC_PAD            16      // weights per AVX2 vector
+
+class PERCEPTRON{
+
+ private:
+  UINT32  histLen;
+  UINT32  numTables;
+  UINT32  rowMask;
+  INT32   theta;          // train while |output| <= theta
+
+  // table t weighs the outcomes segStart[t] .. segStart[t]+segLen[t]-1
+  // (0 the newest), one row of stride[t] weights per index
+  UINT32  segStart[MAX_PERC_TABLES];
+  UINT32  segLen[MAX_PERC_TABLES];
+  UINT32  stride[MAX_PERC_TABLES];   // segLen rounded up to PERC_PAD
+  INT16  *weights[MAX_PERC_TABLES];
+  INT16  *laneMask[MAX_PERC_TABLES]; // -1 for the first segLen lanes, 0 for padding
+  INT16  *bias;
+
+  // history as +1/-1, written twice so hist+head is always a contiguous
+  // window of the newest window outcomes
+  INT16  *hist;
+  UINT32  window;         // covers every segment and its padding
+  UINT32  head;
+
+  GLOBAL_HISTORY  *ghist;                    // feeds the folds
+  FOLDED_HISTORY   indexFold[MAX_PERC_TABLES];
+
+  // lookup state of the last GetPrediction, reused by Update
+  UINT32  biasRow;
+  UINT32  row[MAX_PERC_TABLES];
+  INT32   output;
+
+ public:
+  PERCEPTRON(UINT32 tables, UINT32 logRows, UINT32 historyLength);
+  ~PERCEPTRON();
+
+  bool    GetPrediction(UINT32 PC);
+  void    Update(UINT32 PC, bool resolveDir);
+  bool    PredictAndUpdate(UINT32 PC, bool resolveDir){
+    bool predDir = GetPrediction(PC);
+    Update(PC, resolveDir);
+    return predDir;
+  }
+
+  UINT64  GetStorageBytes();
+};
+
+const char *PerceptronSimdName();
+
+
+/***********************************************************/
+#endif
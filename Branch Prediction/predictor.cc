@@ -1,55 +1,276 @@
 #include <assert.h>
+#include <thread>
 #include "predictor.h"
 
+extern UINT32 PRED_TYPE;
 
-#define PHT_CTR_MAX  3
-#define PHT_CTR_INIT 2
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
 
-// These are hard coded for this assignment
+PREDICTOR::PREDICTOR(void){
+  PREDICTOR_CONFIG cfg;
+  cfg.type = PRED_TYPE;
+  Init(cfg);
+}
 
-#define HIST_LEN        16
-#define TABLE_ENTRIES   (1<<16)
+PREDICTOR::PREDICTOR(UINT32 type){
+  PREDICTOR_CONFIG cfg;
+  cfg.type = type;
+  Init(cfg);
+}
 
-extern UINT32 PRED_TYPE;
+PREDICTOR::PREDICTOR(const PREDICTOR_CONFIG &cfg){
+  Init(cfg);
+}
 
 /////////////////////////////////////////////////////////////
+// Exit with a message if any parameter of cfg is out of range
 /////////////////////////////////////////////////////////////
 
-PREDICTOR::PREDICTOR(void){
+void CheckPredictorConfig(const PREDICTOR_CONFIG &cfg){
+
+  if(cfg.type >= PRED_TYPE_MAX){
+    printf("Undefined Predictor Type\n");
+    exit(-1);
+  }
+  if(cfg.logTableEntries < 1 || cfg.logTableEntries > MAX_LOG_TABLE_ENTRIES){
+    printf("Table size must be 2^1 to 2^%d entries\n", MAX_LOG_TABLE_ENTRIES);
+    exit(-1);
+  }
+  if(cfg.ctrBits < 1 || cfg.ctrBits > COUNTER_MAX_BITS){
+    printf("Counter width must be 1 to %d bits\n", COUNTER_MAX_BITS);
+    exit(-1);
+  }
+  if(cfg.histLen < 1 || cfg.histLen > MAX_HIST_LEN){
+    printf("History length must be 1 to %d bits\n", MAX_HIST_LEN);
+    exit(-1);
+  }
+  if(cfg.pcBits > MAX_LOG_TABLE_ENTRIES ||
+     (cfg.type == PRED_TYPE_TWOLEVEL_PRED && cfg.histLen > MAX_LOG_TABLE_ENTRIES) ||
+     (cfg.type == PRED_TYPE_GSELECT && cfg.pcBits+cfg.histLen > MAX_LOG_TABLE_ENTRIES)){
+    printf("PHT index can have at most %d bits\n", MAX_LOG_TABLE_ENTRIES);
+    exit(-1);
+  }
+  if(cfg.type == PRED_TYPE_TAGE){
+    if(cfg.tageTables < 1 || cfg.tageTables > MAX_TAGE_TABLES){
+      printf("TAGE needs 1 to %d tagged tables\n", MAX_TAGE_TABLES);
+      exit(-1);
+    }
+    if(cfg.tageLogEntries < 1 || cfg.tageLogEntries > MAX_LOG_TABLE_ENTRIES){
+      printf("TAGE tables must have 2^1 to 2^%d entries\n", MAX_LOG_TABLE_ENTRIES);
+      exit(-1);
+    }
+    if(cfg.tageTagBits < 1 || cfg.tageTagBits > MAX_TAGE_TAG_BITS){
+      printf("TAGE tags must be 1 to %d bits\n", MAX_TAGE_TAG_BITS);
+      exit(-1);
+    }
+    if(cfg.tageMinHist < 1 || cfg.tageMinHist > cfg.tageMaxHist ||
+       cfg.tageMaxHist > MAX_TAGE_HIST){
+      printf("TAGE histories must satisfy 1 <= min <= max <= %d\n", MAX_TAGE_HIST);
+      exit(-1);
+    }
+  }
+  if(cfg.type == PRED_TYPE_PAG || cfg.type == PRED_TYPE_PAP){
+    if(cfg.bhtLogEntries > MAX_LOG_TABLE_ENTRIES){
+      printf("BHT can have at most 2^%d entries\n", MAX_LOG_TABLE_ENTRIES);
+      exit(-1);
+    }
+    if(cfg.localHistLen < 1 ||
+       cfg.localHistLen + (cfg.type == PRED_TYPE_PAP ? cfg.pcBits : 0) > MAX_LOG_TABLE_ENTRIES){
+      printf("Local history (plus PAp PC bits) must be 1 to %d bits\n", MAX_LOG_TABLE_ENTRIES);
+      exit(-1);
+    }
+  }
+  if(cfg.type == PRED_TYPE_PERCEPTRON){
+    if(cfg.percHist < 1 || cfg.percHist > MAX_PERC_HIST){
+      printf("Perceptron history must be 1 to %d bits\n", MAX_PERC_HIST);
+      exit(-1);
+    }
+    if(cfg.percLogRows > MAX_PERC_LOG_ROWS){
+      printf("Perceptron can have at most 2^%d weight vectors per table\n", MAX_PERC_LOG_ROWS);
+      exit(-1);
+    }
+    if(cfg.percTables < 1 || cfg.percTables > MAX_PERC_TABLES || cfg.percTables > cfg.percHist){
+      printf("Perceptron needs 1 to %d tables, at most one per history bit\n", MAX_PERC_TABLES);
+      exit(-1);
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////
+// Reset the fields the predictor type ignores to their defaults, so
+// configurations that only differ in those fields compare equal
+/////////////////////////////////////////////////////////////
+
+void NormalizePredictorConfig(PREDICTOR_CONFIG *cfg){
+  PREDICTOR_CONFIG defaults;
+  bool usesTable=false, usesCtr=false, usesHist=false, usesPC=false;
+  bool usesTage=false, usesPerc=false, usesLocal=false;
+
+  switch(cfg->type){
+  case PRED_TYPE_LAST_TIME:      usesTable=true; break;
+  case PRED_TYPE_TWOBIT_COUNTER: usesTable=true; usesCtr=true; break;
+  case PRED_TYPE_TWOLEVEL_PRED:  usesHist=true;  usesCtr=true; break;
+  case PRED_TYPE_GSHARE:         usesTable=true; usesHist=true; usesCtr=true; usesPC=true; break;
+  case PRED_TYPE_GSELECT:        usesHist=true;  usesCtr=true; usesPC=true; break;
+  case PRED_TYPE_TOURNAMENT:     usesTable=true; usesHist=true; usesCtr=true; usesPC=true; break;
+  case PRED_TYPE_TAGE:           usesTable=true; usesTage=true; break;
+  case PRED_TYPE_PERCEPTRON:     usesPerc=true; break;
+  case PRED_TYPE_PAG:            usesLocal=true; usesCtr=true; break;
+  case PRED_TYPE_PAP:            usesLocal=true; usesCtr=true; usesPC=true; break;
+  default: break;
+  }
+
+  if(!usesTable) cfg->logTableEntries = defaults.logTableEntries;
+  if(!usesCtr)   cfg->ctrBits         = defaults.ctrBits;
+  if(!usesHist)  cfg->histLen         = defaults.histLen;
+  if(!usesPC)    cfg->pcBits          = defaults.pcBits;
+  if(!usesTage){
+    cfg->tageTables     = defaults.tageTables;
+    cfg->tageLogEntries = defaults.tageLogEntries;
+    cfg->tageTagBits    = defaults.tageTagBits;
+    cfg->tageMinHist    = defaults.tageMinHist;
+    cfg->tageMaxHist    = defaults.tageMaxHist;
+  }
+  if(!usesPerc){
+    cfg->percHist       = defaults.percHist;
+    cfg->percLogRows    = defaults.percLogRows;
+    cfg->percTables     = defaults.percTables;
+  }
+  if(!usesLocal){
+    cfg->bhtLogEntries  = defaults.bhtLogEntries;
+    cfg->localHistLen   = defaults.localHistLen;
+  }
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+void PREDICTOR::Init(const PREDICTOR_CONFIG &cfg){
+
+  CheckPredictorConfig(cfg);
+
+  config    = cfg;
+  tableMask = (1<<config.logTableEntries)-1;
+
+  // Only the tables of the active predictor are allocated
+  lastTimeTable      = NULL;
+  twoBitCounterTable = NULL;
+  PHT                = NULL;
+  chooserTable       = NULL;
+  tage               = NULL;
+  perceptron         = NULL;
+  BHT                = NULL;
+
+  // Init for Last Time Predictor: a 1 bit counter is the last direction
+  if(config.type == PRED_TYPE_LAST_TIME){
+    lastTimeTable = new COUNTER_TABLE(tableMask+1, 1, NOT_TAKEN);
+  }
+
+
+  // Init for TwoBit Counter: strongly not taken
+  if(config.type == PRED_TYPE_TWOBIT_COUNTER || config.type == PRED_TYPE_TOURNAMENT){
+    twoBitCounterTable = new COUNTER_TABLE(tableMask+1, config.ctrBits, 0);
+  }
+
+
+  // Init for Two Level Predictor: weakly taken. gshare indexes with the
+  // wider of PC and history, gselect with both side by side. A gshare
+  // history longer than logTableEntries is folded down to it.
+  historyLength    = config.histLen;
+  globalHist       = NULL;
+  pcMask           = (1<< config.pcBits)-1;
+
+  numPhtEntries    = 0;
+  phtMask          = 0;
+
+  // a PHT index for the types that have one; other types may use
+  // histories far longer than any index
+  if(config.type == PRED_TYPE_TWOLEVEL_PRED || config.type == PRED_TYPE_GSHARE ||
+     config.type == PRED_TYPE_GSELECT || config.type == PRED_TYPE_TOURNAMENT){
+    UINT32 indexBits = historyLength;
+    if(config.type == PRED_TYPE_GSHARE || config.type == PRED_TYPE_TOURNAMENT){
+      if(indexBits > config.logTableEntries){
+	indexBits = config.logTableEntries;
+      }
+      if(config.pcBits > indexBits){
+	indexBits = config.pcBits;
+      }
+    }
+    if(config.type == PRED_TYPE_GSELECT){
+      indexBits = config.pcBits + historyLength;
+    }
+    numPhtEntries    = (1<< indexBits);
+    phtMask          = numPhtEntries-1;
+
+    PHT = new COUNTER_TABLE(numPhtEntries, config.ctrBits, 1<<(config.ctrBits-1));
+
+    GHR.Init(historyLength, (config.type == PRED_TYPE_GSELECT) ? historyLength : indexBits);
+    if(GHR.NeedsHistory()){
+      globalHist = new GLOBAL_HISTORY(historyLength);
+    }
+  }
+
+
+  // Init for PAg/PAp: cleared local histories, weakly taken PHT
+  if(config.type == PRED_TYPE_PAG || config.type == PRED_TYPE_PAP){
+    bhtMask       = (1<< config.bhtLogEntries)-1;
+    localHistMask = (1<< config.localHistLen)-1;
+
+    BHT = new UINT32[bhtMask+1];
+    for(UINT32 ii=0; ii<= bhtMask; ii++){
+      BHT[ii]=0;
+    }
 
-  // Init for Last Time Predictor
-  lastTimeTable = new UINT32[TABLE_ENTRIES];
-  for(UINT32 ii=0; ii< TABLE_ENTRIES; ii++){
-    lastTimeTable[ii]=NOT_TAKEN;
+    UINT32 indexBits = config.localHistLen;
+    if(config.type == PRED_TYPE_PAP){
+      indexBits += config.pcBits;
+    }
+    numPhtEntries = (1<< indexBits);
+    phtMask       = numPhtEntries-1;
+    PHT = new COUNTER_TABLE(numPhtEntries, config.ctrBits, 1<<(config.ctrBits-1));
   }
 
 
-  // Init for TwoBit Counter
-  twoBitCounterTable = new UINT32[TABLE_ENTRIES];
-  for(UINT32 ii=0; ii< TABLE_ENTRIES; ii++){
-    twoBitCounterTable[ii]=0;
+  // Init for Tournament: the bimodal table above, the gshare PHT, and a
+  // 2 bit chooser per PC starting weakly on the bimodal side
+  if(config.type == PRED_TYPE_TOURNAMENT){
+    chooserTable = new COUNTER_TABLE(tableMask+1, 2, 1);
   }
+  ResetStats();
 
 
-  // Init for Two Level Predictor
-  historyLength    = HIST_LEN;
-  GHR              = 0;
-  numPhtEntries    = (1<< HIST_LEN);
+  // Init for TAGE
+  if(config.type == PRED_TYPE_TAGE){
+    tage = new TAGE(config.logTableEntries, config.tageTables, config.tageLogEntries,
+		    config.tageTagBits, config.tageMinHist, config.tageMaxHist);
+  }
 
-  PHT = new UINT32[numPhtEntries];
 
-  for(UINT32 ii=0; ii< numPhtEntries; ii++){
-    PHT[ii]=PHT_CTR_INIT; 
+  // Init for Perceptron: all weights zero
+  if(config.type == PRED_TYPE_PERCEPTRON){
+    perceptron = new PERCEPTRON(config.percTables, config.percLogRows, config.percHist);
   }
   
 }
 
+PREDICTOR::~PREDICTOR(){
+  delete lastTimeTable;
+  delete twoBitCounterTable;
+  delete PHT;
+  delete chooserTable;
+  delete globalHist;
+  delete tage;
+  delete perceptron;
+  delete [] BHT;
+}
+
 /////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////
 
 bool   PREDICTOR::GetPrediction(UINT32 PC){
 
-  switch(PRED_TYPE){
+  switch(config.type){
 
   case PRED_TYPE_NEVERTAKEN: 
     return NOT_TAKEN;
@@ -66,6 +287,25 @@ bool   PREDICTOR::GetPrediction(UINT32 PC){
   case PRED_TYPE_TWOLEVEL_PRED:
     return GetPredictionTwoLevelPred(PC);
 
+  case PRED_TYPE_GSHARE:
+    return GetPredictionGsharePred(PC);
+
+  case PRED_TYPE_GSELECT:
+    return GetPredictionGselectPred(PC);
+
+  case PRED_TYPE_TOURNAMENT:
+    return GetPredictionTournamentPred(PC);
+
+  case PRED_TYPE_TAGE:
+    return GetPredictionTagePred(PC);
+
+  case PRED_TYPE_PERCEPTRON:
+    return GetPredictionPerceptronPred(PC);
+
+  case PRED_TYPE_PAG:
+  case PRED_TYPE_PAP:
+    return GetPredictionLocalPred(PC);
+
   default: printf("Undefined Predictor Type\n");
            exit(-1);
   }
@@ -78,7 +318,7 @@ bool   PREDICTOR::GetPrediction(UINT32 PC){
 
 void  PREDICTOR::UpdatePredictor(UINT32 PC, bool resolveDir, bool predDir){
 
-  switch(PRED_TYPE){
+  switch(config.type){
 
   case PRED_TYPE_NEVERTAKEN: 
     return; 
@@ -98,20 +338,249 @@ void  PREDICTOR::UpdatePredictor(UINT32 PC, bool resolveDir, bool predDir){
     UpdateTwoLevelPred(PC, resolveDir, predDir);
     return;
 
+  case PRED_TYPE_GSHARE:
+    UpdateGsharePred(PC, resolveDir, predDir);
+    return;
+
+  case PRED_TYPE_GSELECT:
+    UpdateGselectPred(PC, resolveDir, predDir);
+    return;
+
+  case PRED_TYPE_TOURNAMENT:
+    UpdateTournamentPred(PC, resolveDir, predDir);
+    return;
+
+  case PRED_TYPE_TAGE:
+    UpdateTagePred(PC, resolveDir, predDir);
+    return;
+
+  case PRED_TYPE_PERCEPTRON:
+    UpdatePerceptronPred(PC, resolveDir, predDir);
+    return;
+
+  case PRED_TYPE_PAG:
+  case PRED_TYPE_PAP:
+    UpdateLocalPred(PC, resolveDir, predDir);
+    return;
+
+  default: printf("Undefined Predictor Type\n");
+           exit(-1);
+  }
+
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+UINT64  PREDICTOR::GetStorageBytes(){
+  UINT64 bytes=0;
+
+  if(lastTimeTable)      bytes += lastTimeTable->GetNumBytes();
+  if(twoBitCounterTable) bytes += twoBitCounterTable->GetNumBytes();
+  if(PHT)                bytes += PHT->GetNumBytes();
+  if(chooserTable)       bytes += chooserTable->GetNumBytes();
+  if(tage)               bytes += tage->GetStorageBytes();
+  if(perceptron)         bytes += perceptron->GetStorageBytes();
+  if(BHT)                bytes += ((UINT64)(bhtMask+1)*config.localHistLen + 7)/8;
+
+  return bytes;
+}
+
+/////////////////////////////////////////////////////////////
+// Clear the statistics but keep the trained tables, e.g. after a warmup
+/////////////////////////////////////////////////////////////
+
+void  PREDICTOR::ResetStats(){
+  statBimodalChosen        = 0;
+  statGlobalChosen         = 0;
+  statBimodalChosenCorrect = 0;
+  statGlobalChosenCorrect  = 0;
+  statBimodalCorrect       = 0;
+  statGlobalCorrect        = 0;
+
+  if(tage != NULL){
+    tage->ResetStats();
+  }
+}
+
+void  PREDICTOR::PrintStats(){
+
+  if(config.type == PRED_TYPE_TOURNAMENT){
+    printf("\nBIMODAL_CHOSEN       \t : %10llu",   statBimodalChosen);
+    printf("\nBIMODAL_CHOSEN_RIGHT \t : %10llu",   statBimodalChosenCorrect);
+    printf("\nBIMODAL_RIGHT        \t : %10llu",   statBimodalCorrect);
+    printf("\nGLOBAL_CHOSEN        \t : %10llu",   statGlobalChosen);
+    printf("\nGLOBAL_CHOSEN_RIGHT  \t : %10llu",   statGlobalChosenCorrect);
+    printf("\nGLOBAL_RIGHT         \t : %10llu",   statGlobalCorrect);
+  }
+
+  if(config.type == PRED_TYPE_TAGE){
+    tage->PrintStats();
+  }
+
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+template<UINT32 TYPE>
+static UINT64 SimulateBranchesType(PREDICTOR *brpred, const COND_TRACE_RECORD *rec,
+				   UINT64 numRecords){
+  UINT64 numMispred=0;
+
+  for(UINT64 ii=0; ii< numRecords; ii++){
+    bool resolveDir = rec[ii].gapDir & 1;
+    bool predDir    = brpred->PredictAndUpdate<TYPE>(rec[ii].PC, resolveDir);
+    numMispred += (predDir != resolveDir);
+  }
+
+  return numMispred;
+}
+
+UINT64  PREDICTOR::SimulateBranches(const COND_TRACE_RECORD *rec, UINT64 numRecords){
+
+  switch(config.type){
+  case PRED_TYPE_NEVERTAKEN:     return SimulateBranchesType<PRED_TYPE_NEVERTAKEN>(this, rec, numRecords);
+  case PRED_TYPE_ALWAYSTAKEN:    return SimulateBranchesType<PRED_TYPE_ALWAYSTAKEN>(this, rec, numRecords);
+  case PRED_TYPE_LAST_TIME:      return SimulateBranchesType<PRED_TYPE_LAST_TIME>(this, rec, numRecords);
+  case PRED_TYPE_TWOBIT_COUNTER: return SimulateBranchesType<PRED_TYPE_TWOBIT_COUNTER>(this, rec, numRecords);
+  case PRED_TYPE_TWOLEVEL_PRED:  return SimulateBranchesType<PRED_TYPE_TWOLEVEL_PRED>(this, rec, numRecords);
+  case PRED_TYPE_GSHARE:         return SimulateBranchesType<PRED_TYPE_GSHARE>(this, rec, numRecords);
+  case PRED_TYPE_GSELECT:        return SimulateBranchesType<PRED_TYPE_GSELECT>(this, rec, numRecords);
+  case PRED_TYPE_TOURNAMENT:     return SimulateBranchesType<PRED_TYPE_TOURNAMENT>(this, rec, numRecords);
+  case PRED_TYPE_TAGE:           return SimulateBranchesType<PRED_TYPE_TAGE>(this, rec, numRecords);
+  case PRED_TYPE_PERCEPTRON:     return SimulateBranchesType<PRED_TYPE_PERCEPTRON>(this, rec, numRecords);
+  case PRED_TYPE_PAG:            return SimulateBranchesType<PRED_TYPE_PAG>(this, rec, numRecords);
+  case PRED_TYPE_PAP:            return SimulateBranchesType<PRED_TYPE_PAP>(this, rec, numRecords);
   default: printf("Undefined Predictor Type\n");
            exit(-1);
   }
 
 }
 
+/////////////////////////////////////////////////////////////
+// Partitioned replay. Every record is owned by the thread that owns the
+// 64 byte line of the counter it touches, so no line is shared and each
+// counter sees its updates in trace order, as in SimulateBranches.
+// Phase 1: each thread sorts one slice of the records by owner (a
+// counting sort, stable). Phase 2: each owner replays its part of every
+// slice, slice by slice.
+/////////////////////////////////////////////////////////////
+
+static UINT32 PartitionOwner(COUNTER_TABLE *table, UINT32 index, UINT32 numThreads){
+  UINT32 line = table->GetLine(index);
+  return ((UINT64)(line * 0x9e3779b1u) * numThreads) >> 32;   // spread the lines
+}
+
+// bounds[w] is where the records of owner w start within the slice
+static void PartitionSlice(COUNTER_TABLE *table, UINT32 tableMask, const COND_TRACE_RECORD *rec,
+			   UINT64 begin, UINT64 end, UINT32 numThreads,
+			   COND_TRACE_RECORD *sorted, UINT64 *bounds){
+  UINT64 pos[MAX_PARTITION_THREADS];
+
+  for(UINT32 ww=0; ww< numThreads; ww++){
+    pos[ww] = 0;
+  }
+  for(UINT64 ii=begin; ii< end; ii++){
+    pos[PartitionOwner(table, rec[ii].PC & tableMask, numThreads)]++;
+  }
+
+  UINT64 start = begin;
+  for(UINT32 ww=0; ww< numThreads; ww++){
+    UINT64 count = pos[ww];
+    bounds[ww] = start;
+    pos[ww]    = start;
+    start     += count;
+  }
+  bounds[numThreads] = end;
+
+  for(UINT64 ii=begin; ii< end; ii++){
+    sorted[pos[PartitionOwner(table, rec[ii].PC & tableMask, numThreads)]++] = rec[ii];
+  }
+}
+
+static void ReplayPartition(PREDICTOR *brpred, const COND_TRACE_RECORD *sorted,
+			    const UINT64 *bounds, UINT32 numThreads, UINT32 owner,
+			    UINT64 *numMispred){
+  *numMispred = 0;
+  for(UINT32 ss=0; ss< numThreads; ss++){
+    const UINT64 *slice = &bounds[ss*(numThreads+1)];
+    *numMispred += brpred->SimulateBranches(sorted + slice[owner], slice[owner+1]-slice[owner]);
+  }
+}
+
+UINT64  PREDICTOR::SimulateBranchesPartitioned(const COND_TRACE_RECORD *rec, UINT64 numRecords,
+					       UINT32 numThreads){
+
+  if(!HasPcOnlyState() || numThreads <= 1){
+    return SimulateBranches(rec, numRecords);
+  }
+  if(numThreads > MAX_PARTITION_THREADS){
+    numThreads = MAX_PARTITION_THREADS;
+  }
+
+  COUNTER_TABLE     *table   = (config.type == PRED_TYPE_LAST_TIME) ? lastTimeTable : twoBitCounterTable;
+  COND_TRACE_RECORD *sorted  = new COND_TRACE_RECORD[numRecords];
+  UINT64            *bounds  = new UINT64[numThreads*(numThreads+1)];
+  UINT64            *mispred = new UINT64[numThreads];
+  std::thread       *workers = new std::thread[numThreads];
+  UINT64             numMispred = 0;
+
+  for(UINT32 ss=0; ss< numThreads; ss++){
+    workers[ss] = std::thread(PartitionSlice, table, tableMask, rec,
+			      numRecords*ss/numThreads, numRecords*(ss+1)/numThreads,
+			      numThreads, sorted, &bounds[ss*(numThreads+1)]);
+  }
+  for(UINT32 ss=0; ss< numThreads; ss++){
+    workers[ss].join();
+  }
+
+  for(UINT32 ww=0; ww< numThreads; ww++){
+    workers[ww] = std::thread(ReplayPartition, this, sorted, bounds, numThreads, ww, &mispred[ww]);
+  }
+  for(UINT32 ww=0; ww< numThreads; ww++){
+    workers[ww].join();
+    numMispred += mispred[ww];
+  }
+
+  delete [] sorted;
+  delete [] bounds;
+  delete [] mispred;
+  delete [] workers;
+  return numMispred;
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+const char *PredTypeName(UINT32 type){
+
+  switch(type){
+  case PRED_TYPE_NEVERTAKEN:     return "NEVERTAKEN";
+  case PRED_TYPE_ALWAYSTAKEN:    return "ALWAYSTAKEN";
+  case PRED_TYPE_LAST_TIME:      return "LAST_TIME";
+  case PRED_TYPE_TWOBIT_COUNTER: return "TWOBIT_COUNTER";
+  case PRED_TYPE_TWOLEVEL_PRED:  return "TWOLEVEL_PRED";
+  case PRED_TYPE_GSHARE:         return "GSHARE";
+  case PRED_TYPE_GSELECT:        return "GSELECT";
+  case PRED_TYPE_TOURNAMENT:     return "TOURNAMENT";
+  case PRED_TYPE_TAGE:           return "TAGE";
+  case PRED_TYPE_PERCEPTRON:     return "PERCEPTRON";
+  case PRED_TYPE_PAG:            return "PAG";
+  case PRED_TYPE_PAP:            return "PAP";
+  default:                       return "UNDEFINED";
+  }
+
+}
+
 /////////////////////////////////////////////////////////////
 //  LAST TIME PREDICTOR IS ALREADY IMPLEMENTED
 /////////////////////////////////////////////////////////////
 
 bool   PREDICTOR::GetPredictionLastTimePred(UINT32 PC){
 
-  UINT32 tableIndex   = (PC) % TABLE_ENTRIES; // Need to index the table
-  UINT32 tableEntry= lastTimeTable[tableIndex];
+  UINT32 tableIndex   = (PC) & tableMask; // Need to index the table
+  UINT32 tableEntry= lastTimeTable->Get(tableIndex);
   
   if(tableEntry == TAKEN){
     return TAKEN; 
@@ -127,12 +596,12 @@ bool   PREDICTOR::GetPredictionLastTimePred(UINT32 PC){
 
 void  PREDICTOR::UpdateLastTimePred(UINT32 PC, bool resolveDir, bool predDir){
 
-  UINT32 tableIndex   = (PC) % TABLE_ENTRIES; // Need to index the table
+  UINT32 tableIndex   = (PC) & tableMask; // Need to index the table
 
   if(resolveDir==TAKEN){
-    lastTimeTable[tableIndex]=TAKEN;  // store the resolved direction
+    lastTimeTable->Set(tableIndex, TAKEN);  // store the resolved direction
   }else{
-    lastTimeTable[tableIndex]=NOT_TAKEN;  // store the resolved direction
+    lastTimeTable->Set(tableIndex, NOT_TAKEN);  // store the resolved direction
   }
 
 }
@@ -150,24 +619,14 @@ void  PREDICTOR::UpdateLastTimePred(UINT32 PC, bool resolveDir, bool predDir){
 
 bool   PREDICTOR::GetPredictionTwoBitCounterPred(UINT32 PC){
 
-  //assert(0); // NOT IMLEMENTED YET
-  UINT32 tableIndex   = (PC) % TABLE_ENTRIES; // Need to index the table
-  UINT32 tableEntry= twoBitCounterTable[tableIndex];
-  
-  if(tableEntry == 0){
-    return NOT_TAKEN; 
-  }
-  else if(tableEntry == 1){
-    return NOT_TAKEN;
-  }
-  else if(tableEntry == 2){
+  UINT32 tableIndex   = (PC) & tableMask; // Need to index the table
+
+  // upper half of the counter range predicts taken
+  if(twoBitCounterTable->IsTaken(tableIndex)){
     return TAKEN;
   }
-  else if(tableEntry == 3){
-    return TAKEN; 
-  }
   else{
-    return TAKEN; // to avoid warning, remove it
+    return NOT_TAKEN;
   }
 }
 
@@ -177,16 +636,17 @@ bool   PREDICTOR::GetPredictionTwoBitCounterPred(UINT32 PC){
 
 
 void  PREDICTOR::UpdateTwoBitCounterPred(UINT32 PC, bool resolveDir, bool predDir){
-  UINT32 tableIndex   = (PC) % TABLE_ENTRIES; // Need to index the table
+  UINT32 tableIndex   = (PC) & tableMask; // Need to index the table
+  UINT32 tableEntry   = twoBitCounterTable->Get(tableIndex);
 
   if(resolveDir == TAKEN){
-    if(twoBitCounterTable[tableIndex] != 3)  
-        twoBitCounterTable[tableIndex]++;  // store the resolved direction
+    tableEntry = SatIncrement(tableEntry, twoBitCounterTable->GetCtrMax());
   }else{
-    if(twoBitCounterTable[tableIndex] != 0) 
-        twoBitCounterTable[tableIndex]--;  // store the resolved direction
+    tableEntry = SatDecrement(tableEntry);
   }
 
+  twoBitCounterTable->Set(tableIndex, tableEntry);  // store the resolved direction
+
 }
 
 
@@ -197,11 +657,10 @@ void  PREDICTOR::UpdateTwoBitCounterPred(UINT32 PC, bool resolveDir, bool predDi
 
 
 bool   PREDICTOR::GetPredictionTwoLevelPred(UINT32 PC){
-  //assert(0); // NOT IMLEMENTED YET
-  //
-  if (PHT[GHR] >=2)
+
+  if (PHT->IsTaken(GHR.Get()))
   {
-    return TAKEN; // to avoid warning, remove it
+    return TAKEN;
   }
   else
   {
@@ -215,27 +674,133 @@ bool   PREDICTOR::GetPredictionTwoLevelPred(UINT32 PC){
 
 
 void  PREDICTOR::UpdateTwoLevelPred(UINT32 PC, bool resolveDir, bool predDir){
+    UINT32 phtEntry = PHT->Get(GHR.Get());
+
     if(resolveDir == TAKEN)
     {
-        if(PHT[GHR] != 3)
-        {
-            PHT[GHR]++;
-        }
+        phtEntry = SatIncrement(phtEntry, PHT->GetCtrMax());
     } else {
-        if(PHT[GHR] != 0)
-        {
-            PHT[GHR]--;
-        }    
+        phtEntry = SatDecrement(phtEntry);
     }
 
+    PHT->Set(GHR.Get(), phtEntry);
+
 
 
     //update GHR
-    GHR = GHR << 1;
-    if (resolveDir == TAKEN)
-    {
-        GHR += TAKEN;
-    }
-    GHR %= numPhtEntries;
+    PushHistory(resolveDir);
+
+}
+
+/////////////////////////////////////////////////////////////
+// GSHARE AND GSELECT: the TwoLevelPred PHT and GHR, indexed with the PC
+// XORed with, or concatenated above, the global history
+/////////////////////////////////////////////////////////////
+
+void  PREDICTOR::UpdatePHT(UINT32 index, bool resolveDir){
+  UINT32 phtEntry = PHT->Get(index);
+
+  if(resolveDir == TAKEN){
+    phtEntry = SatIncrement(phtEntry, PHT->GetCtrMax());
+  }else{
+    phtEntry = SatDecrement(phtEntry);
+  }
+
+  PHT->Set(index, phtEntry);
+
+  PushHistory(resolveDir);
+}
+
+bool   PREDICTOR::GetPredictionGsharePred(UINT32 PC){
+  return PHT->IsTaken(GshareIndex(PC));
+}
+
+void  PREDICTOR::UpdateGsharePred(UINT32 PC, bool resolveDir, bool predDir){
+  UpdatePHT(GshareIndex(PC), resolveDir);
+}
+
+bool   PREDICTOR::GetPredictionGselectPred(UINT32 PC){
+  return PHT->IsTaken(GselectIndex(PC));
+}
+
+void  PREDICTOR::UpdateGselectPred(UINT32 PC, bool resolveDir, bool predDir){
+  UpdatePHT(GselectIndex(PC), resolveDir);
+}
+
+/////////////////////////////////////////////////////////////
+// TOURNAMENT: bimodal and gshare components both train on every branch;
+// the PC indexed chooser moves toward whichever was right when they
+// disagree
+/////////////////////////////////////////////////////////////
+
+bool   PREDICTOR::GetPredictionTournamentPred(UINT32 PC){
+  UINT32 pcIndex = PC & tableMask;
+
+  if(chooserTable->IsTaken(pcIndex)){
+    return PHT->IsTaken(GshareIndex(PC));
+  }
+  return twoBitCounterTable->IsTaken(pcIndex);
+}
+
+void  PREDICTOR::UpdateTournamentPred(UINT32 PC, bool resolveDir, bool predDir){
+  UINT32 pcIndex     = PC & tableMask;
+  bool   useGlobal   = chooserTable->IsTaken(pcIndex);
+  bool   bimodalPred = twoBitCounterTable->IsTaken(pcIndex);
+  bool   globalPred  = PHT->IsTaken(GshareIndex(PC));
+
+  if(bimodalPred != globalPred){
+    chooserTable->PredictAndUpdate(pcIndex, globalPred == resolveDir);
+  }
+  UpdateTournamentStats(useGlobal, bimodalPred, globalPred, resolveDir);
+
+  twoBitCounterTable->PredictAndUpdate(pcIndex, resolveDir);
+  UpdatePHT(GshareIndex(PC), resolveDir);  // also shifts the GHR
+}
+
+/////////////////////////////////////////////////////////////
+// TAGE: see tage.cc
+/////////////////////////////////////////////////////////////
+
+bool   PREDICTOR::GetPredictionTagePred(UINT32 PC){
+  return tage->GetPrediction(PC);
+}
+
+void  PREDICTOR::UpdateTagePred(UINT32 PC, bool resolveDir, bool predDir){
+  tage->Update(PC, resolveDir);
+}
+
+/////////////////////////////////////////////////////////////
+// Perceptron: see perceptron.cc
+/////////////////////////////////////////////////////////////
+
+bool   PREDICTOR::GetPredictionPerceptronPred(UINT32 PC){
+  return perceptron->GetPrediction(PC);
+}
+
+void  PREDICTOR::UpdatePerceptronPred(UINT32 PC, bool resolveDir, bool predDir){
+  perceptron->Update(PC, resolveDir);
+}
+
+/////////////////////////////////////////////////////////////
+// PAg AND PAp: the history register of this branch (BHT) indexes one
+// shared PHT, or with PAp one of 2^pcBits PHTs picked by the PC
+/////////////////////////////////////////////////////////////
+
+bool   PREDICTOR::GetPredictionLocalPred(UINT32 PC){
+  return PHT->IsTaken(LocalIndex(PC, BHT[PC & bhtMask]));
+}
+
+void  PREDICTOR::UpdateLocalPred(UINT32 PC, bool resolveDir, bool predDir){
+  UINT32 *localHist = &BHT[PC & bhtMask];
+  UINT32  index     = LocalIndex(PC, *localHist);
+  UINT32  phtEntry  = PHT->Get(index);
+
+  if(resolveDir == TAKEN){
+    phtEntry = SatIncrement(phtEntry, PHT->GetCtrMax());
+  }else{
+    phtEntry = SatDecrement(phtEntry);
+  }
+  PHT->Set(index, phtEntry);
 
+  *localHist = ((*localHist << 1) | (resolveDir ? TAKEN : NOT_TAKEN)) & localHistMask;
 }
@@ -3,6 +3,10 @@
 
 #include "utils.h"
 #include "tracer.h"
+#include "counters.h"
+#include "history.h"
+#include "tage.h"
+#include "perceptron.h"
 
 
 
@@ -12,10 +16,82 @@ typedef enum {
   PRED_TYPE_LAST_TIME     =2,
   PRED_TYPE_TWOBIT_COUNTER=3,
   PRED_TYPE_TWOLEVEL_PRED =4,
-  PRED_TYPE_MAX           =5
+  PRED_TYPE_GSHARE        =5,
+  PRED_TYPE_GSELECT       =6,
+  PRED_TYPE_TOURNAMENT    =7,
+  PRED_TYPE_TAGE          =8,
+  PRED_TYPE_PERCEPTRON    =9,
+  PRED_TYPE_PAG           =10,
+  PRED_TYPE_PAP           =11,
+  PRED_TYPE_MAX           =12
 }PredType;
 
 
+// Default geometry is the one hard coded for the original assignment
+
+#define DEFAULT_HIST_LEN            16
+#define DEFAULT_LOG_TABLE_ENTRIES   16
+#define DEFAULT_CTR_BITS            2
+#define DEFAULT_PC_BITS             8
+
+#define DEFAULT_TAGE_TABLES         7
+#define DEFAULT_TAGE_LOG_ENTRIES    10
+#define DEFAULT_TAGE_TAG_BITS       10
+#define DEFAULT_TAGE_MIN_HIST       4
+#define DEFAULT_TAGE_MAX_HIST       160
+
+#define DEFAULT_PERC_HIST           64
+#define DEFAULT_PERC_LOG_ROWS       10
+#define DEFAULT_PERC_TABLES         4
+
+#define DEFAULT_BHT_LOG_ENTRIES     10
+#define DEFAULT_LOCAL_HIST_LEN      10
+
+#define MAX_HIST_LEN                4096
+#define MAX_LOG_TABLE_ENTRIES       30
+#define MAX_PARTITION_THREADS       256
+
+
+/////////////////////////////////////////////////////////////
+// Runtime parameters of a PREDICTOR, checked when it is built
+/////////////////////////////////////////////////////////////
+
+class PREDICTOR_CONFIG{
+  public:
+  UINT32  type;
+  UINT32  logTableEntries;  // log2 entries of the PC indexed tables
+  UINT32  ctrBits;          // width of the two bit counter and PHT counters
+  UINT32  histLen;          // global history bits; the PHT has 2^histLen entries
+  UINT32  pcBits;           // PC bits hashed into the gshare/gselect PHT index
+  UINT32  tageTables;       // tagged tables of TAGE
+  UINT32  tageLogEntries;   // log2 entries per tagged table
+  UINT32  tageTagBits;
+  UINT32  tageMinHist;      // history of the first tagged table
+  UINT32  tageMaxHist;      // history of the last tagged table
+  UINT32  percHist;         // global history bits of the perceptron
+  UINT32  percLogRows;      // log2 weight vectors per perceptron table
+  UINT32  percTables;       // perceptron tables, one per history segment
+  UINT32  bhtLogEntries;    // log2 local history registers of PAg/PAp
+  UINT32  localHistLen;     // bits per local history register
+
+  PREDICTOR_CONFIG(){
+    type=PRED_TYPE_NEVERTAKEN;
+    logTableEntries=DEFAULT_LOG_TABLE_ENTRIES;
+    ctrBits=DEFAULT_CTR_BITS;
+    histLen=DEFAULT_HIST_LEN;
+    pcBits=DEFAULT_PC_BITS;
+    tageTables=DEFAULT_TAGE_TABLES;
+    tageLogEntries=DEFAULT_TAGE_LOG_ENTRIES;
+    tageTagBits=DEFAULT_TAGE_TAG_BITS;
+    tageMinHist=DEFAULT_TAGE_MIN_HIST;
+    tageMaxHist=DEFAULT_TAGE_MAX_HIST;
+    percHist=DEFAULT_PERC_HIST;
+    percLogRows=DEFAULT_PERC_LOG_ROWS;
+    percTables=DEFAULT_PERC_TABLES;
+    bhtLogEntries=DEFAULT_BHT_LOG_ENTRIES;
+    localHistLen=DEFAULT_LOCAL_HIST_LEN;
+  }
+};
 
 
 /////////////////////////////////////////////////////////////
@@ -25,19 +101,48 @@ class PREDICTOR{
 
 
  private:
-  UINT32  *lastTimeTable;  // for LastTime Predictor
+  PREDICTOR_CONFIG config;
 
-  UINT32  *twoBitCounterTable; // for TwoBitCounter Predictor
+  UINT32  tableMask;      // PC index mask of lastTimeTable, twoBitCounterTable
 
-  UINT32  GHR; // Global History Register for TwoLevelPred
-  UINT32  *PHT;          // pattern history table for TwoLevelPred
+  COUNTER_TABLE  *lastTimeTable;  // for LastTime Predictor
+
+  COUNTER_TABLE  *twoBitCounterTable; // for TwoBitCounter Predictor
+
+  GLOBAL_HISTORY *globalHist; // last historyLength outcomes, if GHR has to fold them
+  FOLDED_HISTORY  GHR;   // Global History Register for TwoLevelPred, folded to the PHT index
+  COUNTER_TABLE  *PHT;   // pattern history table for TwoLevelPred
   UINT32  historyLength; // history length for TwoLevelPred
   UINT32  numPhtEntries; // entries in pht for TwoLevelPred
+  UINT32  phtMask;       // numPhtEntries-1
+  UINT32  pcMask;        // PC bits used by gshare/gselect
+
+  // Tournament: twoBitCounterTable (bimodal) and gshare PHT, chosen per PC
+  COUNTER_TABLE  *chooserTable;  // upper half selects the global component
+  UINT64  statBimodalChosen;
+  UINT64  statGlobalChosen;
+  UINT64  statBimodalChosenCorrect;
+  UINT64  statGlobalChosenCorrect;
+  UINT64  statBimodalCorrect;    // whether chosen or not
+  UINT64  statGlobalCorrect;
+
+  TAGE   *tage;           // for TAGE, base table sized by tableMask
+
+  PERCEPTRON *perceptron; // for Perceptron
+
+  // PAg/PAp: per-branch histories index the PHT above, PAp also with
+  // pcBits of the PC to pick one of 2^pcBits pattern tables
+  UINT32 *BHT;            // branch history table of local history registers
+  UINT32  bhtMask;
+  UINT32  localHistMask;
 
  public:
 
   // The interface to the four functions below CAN NOT be changed
   PREDICTOR(void);
+  PREDICTOR(UINT32 type);   // for running several predictors side by side
+  PREDICTOR(const PREDICTOR_CONFIG &cfg);
+  ~PREDICTOR();
   bool    GetPrediction(UINT32 PC);  
   void    UpdatePredictor(UINT32 PC, bool resolveDir, bool predDir);
 
@@ -48,8 +153,166 @@ class PREDICTOR{
   void    UpdateLastTimePred(UINT32 PC, bool resolveDir, bool predDir);
   void    UpdateTwoBitCounterPred(UINT32 PC, bool resolveDir, bool predDir);
   void    UpdateTwoLevelPred(UINT32 PC, bool resolveDir, bool predDir);
+
+  // Two level predictors that also index the PHT with the PC
+  bool    GetPredictionGsharePred(UINT32 PC);
+  bool    GetPredictionGselectPred(UINT32 PC);
+  void    UpdateGsharePred(UINT32 PC, bool resolveDir, bool predDir);
+  void    UpdateGselectPred(UINT32 PC, bool resolveDir, bool predDir);
+
+  // McFarling combining predictor
+  bool    GetPredictionTournamentPred(UINT32 PC);
+  void    UpdateTournamentPred(UINT32 PC, bool resolveDir, bool predDir);
+
+  bool    GetPredictionTagePred(UINT32 PC);
+  void    UpdateTagePred(UINT32 PC, bool resolveDir, bool predDir);
+
+  bool    GetPredictionPerceptronPred(UINT32 PC);
+  void    UpdatePerceptronPred(UINT32 PC, bool resolveDir, bool predDir);
+
+  // Local history two level predictors
+  bool    GetPredictionLocalPred(UINT32 PC);
+  void    UpdateLocalPred(UINT32 PC, bool resolveDir, bool predDir);
+
+  UINT32  GetPredType(){ return config.type; }
+  const PREDICTOR_CONFIG &GetConfig(){ return config; }
+  UINT64  GetStorageBytes();
+
+  // Per-type statistics beyond the misprediction count, if any
+  bool    HasStats(){ return config.type == PRED_TYPE_TOURNAMENT ||
+			 config.type == PRED_TYPE_TAGE; }
+  void    ResetStats();
+  void    PrintStats();
+
+  // Replay an in-memory run of conditional branches through the
+  // specialized loop; returns the number of mispredictions.
+  UINT64  SimulateBranches(const COND_TRACE_RECORD *rec, UINT64 numRecords);
+
+  // The same on numThreads threads, with an identical result, for
+  // predictors whose only state is PC indexed counter tables; others
+  // fall back to SimulateBranches.
+  bool    HasPcOnlyState(){ return config.type == PRED_TYPE_LAST_TIME ||
+			       config.type == PRED_TYPE_TWOBIT_COUNTER; }
+  UINT64  SimulateBranchesPartitioned(const COND_TRACE_RECORD *rec, UINT64 numRecords,
+				      UINT32 numThreads);
+
+  // Prediction and update fused into one inlined call, with the predictor
+  // type fixed at compile time. Returns the prediction made before update.
+  template<UINT32 TYPE>
+  bool    PredictAndUpdate(UINT32 PC, bool resolveDir);
+
+ private:
+  void    Init(const PREDICTOR_CONFIG &cfg);
+  void    UpdatePHT(UINT32 index, bool resolveDir);
+
+  // PC XOR history, and PC bits concatenated above history
+  UINT32  GshareIndex(UINT32 PC){ return ((PC & pcMask) ^ GHR.Get()) & phtMask; }
+  UINT32  GselectIndex(UINT32 PC){ return ((PC & pcMask) << historyLength) | GHR.Get(); }
+
+  UINT32  LocalIndex(UINT32 PC, UINT32 localHist){
+    return (config.type == PRED_TYPE_PAP) ?
+      ((PC & pcMask) << config.localHistLen) | localHist : localHist;
+  }
+
+  void    PushHistory(bool resolveDir){
+    if(globalHist) globalHist->Push(resolveDir);
+    GHR.Update(resolveDir, globalHist);
+  }
+
+  void    UpdateTournamentStats(bool useGlobal, bool bimodalPred, bool globalPred,
+				bool resolveDir);
 };
 
+const char *PredTypeName(UINT32 type);
+void        CheckPredictorConfig(const PREDICTOR_CONFIG &cfg);
+void        NormalizePredictorConfig(PREDICTOR_CONFIG *cfg);
+
+
+/////////////////////////////////////////////////////////////
+// Same behavior as GetPrediction followed by UpdatePredictor, but the
+// type switch folds away and each table entry is read once.
+/////////////////////////////////////////////////////////////
+
+template<UINT32 TYPE>
+inline bool PREDICTOR::PredictAndUpdate(UINT32 PC, bool resolveDir){
+
+  if(TYPE == PRED_TYPE_NEVERTAKEN){
+    return NOT_TAKEN;
+  }
+
+  if(TYPE == PRED_TYPE_ALWAYSTAKEN){
+    return TAKEN;
+  }
+
+  if(TYPE == PRED_TYPE_LAST_TIME){
+    return lastTimeTable->PredictAndUpdate(PC & tableMask, resolveDir);
+  }
+
+  if(TYPE == PRED_TYPE_TWOBIT_COUNTER){
+    return twoBitCounterTable->PredictAndUpdate(PC & tableMask, resolveDir);
+  }
+
+  if(TYPE == PRED_TYPE_TAGE){
+    return tage->PredictAndUpdate(PC, resolveDir);
+  }
+
+  if(TYPE == PRED_TYPE_PERCEPTRON){
+    return perceptron->PredictAndUpdate(PC, resolveDir);
+  }
+
+  if(TYPE == PRED_TYPE_PAG || TYPE == PRED_TYPE_PAP){
+    UINT32 *localHist = &BHT[PC & bhtMask];
+    UINT32  index     = (TYPE == PRED_TYPE_PAP) ?
+                        ((PC & pcMask) << config.localHistLen) | *localHist : *localHist;
+    bool pred = PHT->PredictAndUpdate(index, resolveDir);
+    *localHist = ((*localHist << 1) | (resolveDir ? TAKEN : NOT_TAKEN)) & localHistMask;
+    return pred;
+  }
+
+  if(TYPE == PRED_TYPE_TOURNAMENT){
+    UINT32 pcIndex     = PC & tableMask;
+    bool   useGlobal   = chooserTable->IsTaken(pcIndex);
+    bool   bimodalPred = twoBitCounterTable->PredictAndUpdate(pcIndex, resolveDir);
+    bool   globalPred  = PHT->PredictAndUpdate(GshareIndex(PC), resolveDir);
+
+    // the chooser only learns when the components disagree
+    if(bimodalPred != globalPred){
+      chooserTable->PredictAndUpdate(pcIndex, globalPred == resolveDir);
+    }
+    PushHistory(resolveDir);
+
+    UpdateTournamentStats(useGlobal, bimodalPred, globalPred, resolveDir);
+    return useGlobal ? globalPred : bimodalPred;
+  }
+
+  if(TYPE == PRED_TYPE_TWOLEVEL_PRED || TYPE == PRED_TYPE_GSHARE ||
+     TYPE == PRED_TYPE_GSELECT){
+    UINT32 index = (TYPE == PRED_TYPE_GSHARE)  ? GshareIndex(PC)  :
+                   (TYPE == PRED_TYPE_GSELECT) ? GselectIndex(PC) : GHR.Get();
+    bool pred = PHT->PredictAndUpdate(index, resolveDir);
+    PushHistory(resolveDir);
+    return pred;
+  }
+
+  return NOT_TAKEN;
+}
+
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+inline void PREDICTOR::UpdateTournamentStats(bool useGlobal, bool bimodalPred,
+					     bool globalPred, bool resolveDir){
+  bool bimodalCorrect = (bimodalPred == resolveDir);
+  bool globalCorrect  = (globalPred == resolveDir);
+
+  statBimodalChosen        += !useGlobal;
+  statGlobalChosen         += useGlobal;
+  statBimodalChosenCorrect += !useGlobal && bimodalCorrect;
+  statGlobalChosenCorrect  += useGlobal && globalCorrect;
+  statBimodalCorrect       += bimodalCorrect;
+  statGlobalCorrect        += globalCorrect;
+}
 
 
 /***********************************************************/
@@ -0,0 +1,84 @@
+#include "profile.h"
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+BRANCH_PROFILE::BRANCH_PROFILE(){
+  logSlots     = PROFILE_INIT_LOG_SLOTS;
+  numUsed      = 0;
+  totalMispred = 0;
+
+  slots = new PROFILE_ENTRY[1<<logSlots];
+  for(UINT32 ii=0; ii< (1u<<logSlots); ii++){
+    slots[ii].PC      = 0;
+    slots[ii].mispred = 0;
+    slots[ii].exec    = 0;
+    slots[ii].taken   = 0;
+  }
+}
+
+void  BRANCH_PROFILE::Grow(){
+  PROFILE_ENTRY *old      = slots;
+  UINT32         oldSlots = 1<<logSlots;
+
+  logSlots++;
+  slots = new PROFILE_ENTRY[1<<logSlots];
+  for(UINT32 ii=0; ii< (1u<<logSlots); ii++){
+    slots[ii].PC      = 0;
+    slots[ii].mispred = 0;
+    slots[ii].exec    = 0;
+    slots[ii].taken   = 0;
+  }
+
+  for(UINT32 ii=0; ii< oldSlots; ii++){
+    if(old[ii].exec != 0){
+      *Find(old[ii].PC) = old[ii];
+    }
+  }
+  delete [] old;
+}
+
+/////////////////////////////////////////////////////////////
+// Print the topN branches with the most mispredictions, with their
+// bias and their share of all mispredictions.
+/////////////////////////////////////////////////////////////
+
+static int CompareMispred(const void *a, const void *b){
+  const PROFILE_ENTRY *ea = *(const PROFILE_ENTRY * const *)a;
+  const PROFILE_ENTRY *eb = *(const PROFILE_ENTRY * const *)b;
+
+  if(ea->mispred != eb->mispred){
+    return (ea->mispred < eb->mispred) ? 1 : -1;
+  }
+  return (ea->PC < eb->PC) ? -1 : (ea->PC > eb->PC);
+}
+
+void  BRANCH_PROFILE::PrintTop(UINT32 topN){
+  PROFILE_ENTRY **sorted = new PROFILE_ENTRY*[numUsed];
+  UINT32          num    = 0;
+  UINT64          cumMispred = 0;
+
+  for(UINT32 ii=0; ii< (1u<<logSlots); ii++){
+    if(slots[ii].exec != 0){
+      sorted[num++] = &slots[ii];
+    }
+  }
+  qsort(sorted, num, sizeof(sorted[0]), CompareMispred);
+
+  printf("\n\nNUM_STATIC_BR        \t : %10u",   numUsed);
+  printf("\n\n%-4s %-10s %12s %10s %12s %10s %10s", "RANK", "PC", "EXEC",
+	 "TAKEN(%)", "MISPRED", "MISP(%)", "CUMUL(%)");
+
+  for(UINT32 ii=0; ii< num && ii< topN; ii++){
+    PROFILE_ENTRY *entry = sorted[ii];
+
+    cumMispred += entry->mispred;
+    printf("\n%-4u 0x%08x %12llu %10.3f %12llu %10.3f %10.3f", ii+1, entry->PC, entry->exec,
+	   100.0*(double)(entry->taken)/(double)(entry->exec),
+	   entry->mispred,
+	   100.0*(double)(entry->mispred)/(double)(entry->exec),
+	   100.0*(double)(cumMispred)/(double)(totalMispred ? totalMispred : 1));
+  }
+
+  delete [] sorted;
+}
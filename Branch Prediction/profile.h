@@ -0,0 +1,77 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// Per static branch counts of executions, taken outcomes and
+// mispredictions, kept in an open addressing hash map keyed by the PC
+// (linear probing; a slot with no executions is free, so PC 0 is stored
+// like any other). The map doubles when it is half full, so a lookup is
+// almost always one cache line.
+/////////////////////////////////////////////////////////////
+
+#define PROFILE_INIT_LOG_SLOTS  12
+
+typedef struct {
+  UINT32  PC;
+  UINT64  exec;
+  UINT64  taken;
+  UINT64  mispred;
+} PROFILE_ENTRY;
+
+class BRANCH_PROFILE{
+
+ private:
+  PROFILE_ENTRY *slots;
+  UINT32  logSlots;
+  UINT32  numUsed;
+  UINT64  totalMispred;
+
+ public:
+  BRANCH_PROFILE();
+  ~BRANCH_PROFILE(){ delete [] slots; }
+
+  void    Record(UINT32 PC, bool resolveDir, bool mispred);
+  void    PrintTop(UINT32 topN);
+
+ private:
+  PROFILE_ENTRY *Find(UINT32 PC);
+  void    Grow();
+};
+
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+inline PROFILE_ENTRY *BRANCH_PROFILE::Find(UINT32 PC){
+  UINT32 mask = (1<<logSlots)-1;
+  UINT32 slot = (PC * 0x9e3779b1u) >> (32-logSlots);   // Fibonacci hashing
+
+  while(slots[slot].exec != 0 && slots[slot].PC != PC){
+    slot = (slot+1) & mask;
+  }
+  return &slots[slot];
+}
+
+inline void BRANCH_PROFILE::Record(UINT32 PC, bool resolveDir, bool mispred){
+  PROFILE_ENTRY *entry = Find(PC);
+
+  if(entry->exec == 0){
+    if(2*(numUsed+1) > (1u<<logSlots)){
+      Grow();
+      entry = Find(PC);
+    }
+    entry->PC = PC;
+    numUsed++;
+  }
+
+  entry->exec++;
+  entry->taken   += resolveDir;
+  entry->mispred += mispred;
+  totalMispred   += mispred;
+}
+
+
+/***********************************************************/
+#endif
@@ -0,0 +1,102 @@
+#ifndef _RAS_H_
+#define _RAS_H_
+
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// Return address stack. Calls push their PC and returns pop it. The
+// trace has no instruction sizes, so a popped call PC predicts a return
+// correctly when the return lands within RAS_MAX_CALL_BYTES after it.
+//
+// A push onto a full stack either overwrites the oldest entry (wrap)
+// or is lost (drop). A checkpoint saves the top of stack pointer and
+// the top entry, which repairs the common wrong-path corruption.
+/////////////////////////////////////////////////////////////
+
+#define DEFAULT_RAS_DEPTH     16
+#define MAX_RAS_DEPTH         4096
+#define RAS_MAX_CALL_BYTES    16
+
+#define RAS_OVERFLOW_WRAP     0
+#define RAS_OVERFLOW_DROP     1
+
+typedef struct {
+  UINT32  tos;
+  UINT32  count;
+  UINT32  top;
+} RAS_CHECKPOINT;
+
+class RETURN_STACK{
+
+ private:
+  UINT32  *entries;
+  UINT32  depth;
+  UINT32  policy;
+  UINT32  tos;            // index of the top entry
+  UINT32  count;          // valid entries, at most depth
+
+  UINT64  statOverflow;
+
+ public:
+  RETURN_STACK(UINT32 stackDepth, UINT32 overflowPolicy);
+  ~RETURN_STACK(){ delete [] entries; }
+
+  void    Push(UINT32 callPC);
+  bool    Pop(UINT32 *callPC);
+
+  void    Checkpoint(RAS_CHECKPOINT *cp){ cp->tos = tos; cp->count = count; cp->top = entries[tos]; }
+  void    Restore(const RAS_CHECKPOINT *cp){ tos = cp->tos; count = cp->count; entries[tos] = cp->top; }
+
+  UINT64  GetNumOverflows(){ return statOverflow; }
+  void    ResetStats(){ statOverflow = 0; }
+};
+
+static inline bool IsReturnOf(UINT32 callPC, UINT32 target){
+  return target > callPC && target - callPC <= RAS_MAX_CALL_BYTES;
+}
+
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+inline RETURN_STACK::RETURN_STACK(UINT32 stackDepth, UINT32 overflowPolicy){
+  depth   = stackDepth;
+  policy  = overflowPolicy;
+  entries = new UINT32[depth];
+  for(UINT32 ii=0; ii< depth; ii++){
+    entries[ii]=0;
+  }
+  tos   = 0;
+  count = 0;
+
+  statOverflow = 0;
+}
+
+inline void RETURN_STACK::Push(UINT32 callPC){
+  if(count == depth){
+    statOverflow++;
+    if(policy == RAS_OVERFLOW_DROP){
+      return;
+    }
+  }else{
+    count++;
+  }
+
+  tos = (tos+1 == depth) ? 0 : tos+1;
+  entries[tos] = callPC;
+}
+
+inline bool RETURN_STACK::Pop(UINT32 *callPC){
+  if(count == 0){
+    return false;
+  }
+
+  *callPC = entries[tos];
+  tos = (tos == 0) ? depth-1 : tos-1;
+  count--;
+  return true;
+}
+
+
+/***********************************************************/
+#endif
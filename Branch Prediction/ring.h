@@ -0,0 +1,101 @@
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// Lock-free ring of RING_SLOTS batches between one producer thread and
+// one consumer thread. The producer fills the slot returned by
+// ProducerSlot and publishes it with Produce; the consumer reads the
+// slot returned by ConsumerSlot and hands it back with Consume. Each
+// side only writes its own index, so a release store of the index after
+// touching a slot is all the synchronization needed.
+//
+// Waiting for a slot spins briefly, yields the core for a while, then
+// sleeps with doubling naps up to RING_MAX_NAP_US, so a reader that runs
+// ahead of a slow predictor does not hold a second core. The wait gives
+// up (returns NULL) once stop is set, so a producer blocked on a full
+// ring can be shut down.
+/////////////////////////////////////////////////////////////
+
+#define RING_SLOTS       4      // power of two
+#define RING_SPINS       64     // polls before yielding
+#define RING_YIELDS      64     // yields before sleeping
+#define RING_MAX_NAP_US  256    // longest sleep in microseconds
+
+template<typename BATCH>
+class SPSC_RING{
+
+ private:
+  BATCH  slots[RING_SLOTS];
+
+  alignas(64) std::atomic<UINT32> head;  // batches consumed, consumer owned
+  alignas(64) std::atomic<UINT32> tail;  // batches produced, producer owned
+
+ public:
+  SPSC_RING(){ head.store(0); tail.store(0); }
+
+  BATCH  *ProducerSlot(const std::atomic<bool> &stop);
+  void    Produce(){ tail.store(tail.load(std::memory_order_relaxed)+1, std::memory_order_release); }
+
+  BATCH  *ConsumerSlot(const std::atomic<bool> &stop);
+  void    Consume(){ head.store(head.load(std::memory_order_relaxed)+1, std::memory_order_release); }
+
+ private:
+  static void  Wait(UINT32 spins);
+};
+
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+template<typename BATCH>
+void SPSC_RING<BATCH>::Wait(UINT32 spins){
+  if(spins < RING_SPINS){
+    return;
+  }
+  if(spins < RING_SPINS+RING_YIELDS){
+    std::this_thread::yield();
+    return;
+  }
+
+  UINT32 shift = spins-RING_SPINS-RING_YIELDS;
+  UINT32 nap   = RING_MAX_NAP_US;
+  if(shift < 31 && (1u<<shift) < RING_MAX_NAP_US){
+    nap = 1u<<shift;
+  }
+  std::this_thread::sleep_for(std::chrono::microseconds(nap));
+}
+
+template<typename BATCH>
+BATCH *SPSC_RING<BATCH>::ProducerSlot(const std::atomic<bool> &stop){
+  UINT32 pos = tail.load(std::memory_order_relaxed);
+
+  for(UINT32 spins=0; pos - head.load(std::memory_order_acquire) == RING_SLOTS; spins++){
+    if(stop.load(std::memory_order_relaxed)){
+      return NULL;
+    }
+    Wait(spins);
+  }
+  return &slots[pos % RING_SLOTS];
+}
+
+template<typename BATCH>
+BATCH *SPSC_RING<BATCH>::ConsumerSlot(const std::atomic<bool> &stop){
+  UINT32 pos = head.load(std::memory_order_relaxed);
+
+  for(UINT32 spins=0; tail.load(std::memory_order_acquire) == pos; spins++){
+    if(stop.load(std::memory_order_relaxed)){
+      return NULL;
+    }
+    Wait(spins);
+  }
+  return &slots[pos % RING_SLOTS];
+}
+
+
+/***********************************************************/
+#endif
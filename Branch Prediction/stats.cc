@@ -0,0 +1,165 @@
+#include <math.h>
+#include "stats.h"
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+INTERVAL_STATS::INTERVAL_STATS(const char *fileName, UINT64 interval, UINT32 preds,
+			       const char * const *predNames){
+
+  if((out = fopen(fileName, "w")) == NULL){
+    printf("Unable to open the stats file %s. Dying\n", fileName);
+    exit(-1);
+  }
+
+  numPreds       = preds;
+  intervalLen    = interval;
+  nextBoundary   = interval;
+  numIntervals   = 0;
+  lastInst       = 0;
+  lastCondBranch = 0;
+
+  lastMispred = new UINT64[numPreds];
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    lastMispred[ii]=0;
+  }
+
+  fprintf(out, "interval,start_inst,end_inst,cond_br");
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    fprintf(out, ",%u_%s_mispred,%u_%s_mpki,%u_%s_correct_pct",
+	    ii, predNames[ii], ii, predNames[ii], ii, predNames[ii]);
+  }
+  fprintf(out, "\n");
+}
+
+INTERVAL_STATS::~INTERVAL_STATS(){
+  fclose(out);
+  delete [] lastMispred;
+}
+
+// measurement starts here; mispredictions start at zero
+void  INTERVAL_STATS::Start(UINT64 numInst, UINT64 numCondBranch){
+  lastInst       = numInst;
+  lastCondBranch = numCondBranch;
+  nextBoundary   = numInst + intervalLen;
+}
+
+/////////////////////////////////////////////////////////////
+// Write the row for the instructions since the last one; counts are
+// running totals.
+/////////////////////////////////////////////////////////////
+
+void  INTERVAL_STATS::Sample(UINT64 numInst, UINT64 numCondBranch, const UINT64 *numMispred){
+  UINT64 inst = numInst-lastInst;
+  UINT64 cond = numCondBranch-lastCondBranch;
+
+  fprintf(out, "%u,%llu,%llu,%llu", numIntervals, lastInst, numInst, cond);
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    UINT64 mispred = numMispred[ii]-lastMispred[ii];
+
+    fprintf(out, ",%llu,%.3f,%.3f", mispred,
+	    1000.0*(double)(mispred)/(double)(inst ? inst : 1),
+	    100.0-100.0*(double)(mispred)/(double)(cond ? cond : 1));
+    lastMispred[ii] = numMispred[ii];
+  }
+  fprintf(out, "\n");
+
+  numIntervals++;
+  lastInst       = numInst;
+  lastCondBranch = numCondBranch;
+  while(nextBoundary <= numInst){
+    nextBoundary += intervalLen;
+  }
+}
+
+// the last, partial interval
+void  INTERVAL_STATS::Finish(UINT64 numInst, UINT64 numCondBranch, const UINT64 *numMispred){
+  if(numInst > lastInst){
+    Sample(numInst, numCondBranch, numMispred);
+  }
+  fflush(out);
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+SAMPLE_STATS::SAMPLE_STATS(UINT32 preds){
+  numPreds          = preds;
+  numSamples        = 0;
+  sampledInst       = 0;
+  sampledCondBranch = 0;
+
+  sampledMispred = new UINT64[numPreds];
+  meanMpki       = new double[numPreds];
+  sqDevMpki      = new double[numPreds];
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    sampledMispred[ii] = 0;
+    meanMpki[ii]       = 0;
+    sqDevMpki[ii]      = 0;
+  }
+}
+
+SAMPLE_STATS::~SAMPLE_STATS(){
+  delete [] sampledMispred;
+  delete [] meanMpki;
+  delete [] sqDevMpki;
+}
+
+// counts are those of one window
+void  SAMPLE_STATS::AddSample(UINT64 numInst, UINT64 numCondBranch, const UINT64 *numMispred){
+  numSamples++;
+  sampledInst       += numInst;
+  sampledCondBranch += numCondBranch;
+
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    double mpki  = 1000.0*(double)(numMispred[ii])/(double)(numInst);
+    double delta = mpki - meanMpki[ii];
+
+    sampledMispred[ii] += numMispred[ii];
+    meanMpki[ii]       += delta/(double)numSamples;
+    sqDevMpki[ii]      += delta*(mpki - meanMpki[ii]);
+  }
+}
+
+double  SAMPLE_STATS::GetHalfWidth(UINT32 pred){
+  if(numSamples < 2){
+    return 0;
+  }
+  double var = sqDevMpki[pred]/(double)(numSamples-1);
+  return SAMPLE_CONFIDENCE_Z*sqrt(var/(double)numSamples);
+}
+
+/////////////////////////////////////////////////////////////
+// True once every predictor's confidence interval is within
+// targetError percent of its mean MPKI
+/////////////////////////////////////////////////////////////
+
+bool  SAMPLE_STATS::Converged(double targetError){
+  if(numSamples < SAMPLE_MIN_WINDOWS || targetError <= 0){
+    return false;
+  }
+
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    if(GetHalfWidth(ii) > meanMpki[ii]*targetError/100.0){
+      return false;
+    }
+  }
+  return true;
+}
+
+void  SAMPLE_STATS::PrintStats(const char * const *predNames){
+  printf("\nNUM_SAMPLES          \t : %10llu",   numSamples);
+  printf("\nNUM_SAMPLED_INST     \t : %10llu",   sampledInst);
+  printf("\nNUM_SAMPLED_COND_BR  \t : %10llu",   sampledCondBranch);
+
+  printf("\n\n%-3s %-16s %12s %12s %12s %12s", "ID", "PREDICTOR",
+	 "MPKI", "+/-(95%)", "ERROR(%)", "CORRECT(%)");
+  for(UINT32 ii=0; ii< numPreds; ii++){
+    double halfWidth = GetHalfWidth(ii);
+
+    printf("\n%-3u %-16s %12.3f %12.3f %12.3f %12.3f", ii, predNames[ii],
+	   meanMpki[ii], halfWidth,
+	   100.0*halfWidth/(meanMpki[ii] > 0 ? meanMpki[ii] : 1),
+	   100.0-100.0*(double)(sampledMispred[ii])/(double)(sampledCondBranch ? sampledCondBranch : 1));
+  }
+}
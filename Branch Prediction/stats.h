@@ -0,0 +1,85 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// Time series of direction prediction stats: one CSV row per interval
+// of intervalLen instructions with the branches, mispredictions, MPKI
+// and accuracy of every predictor in that interval. Conditional branch
+// only traces advance several instructions per record, so a row ends
+// at the first record at or past its boundary and reports its real
+// instruction count. Counts are running totals, so the first row
+// starts at whatever totals Start was given (after a skip or warmup).
+/////////////////////////////////////////////////////////////
+
+#define DEFAULT_STATS_FILE  "interval_stats.csv"
+
+class INTERVAL_STATS{
+
+ private:
+  FILE   *out;
+  UINT32  numPreds;
+  UINT64  intervalLen;
+  UINT64  nextBoundary;
+  UINT32  numIntervals;
+
+  UINT64  lastInst;       // totals at the end of the previous row
+  UINT64  lastCondBranch;
+  UINT64 *lastMispred;
+
+ public:
+  INTERVAL_STATS(const char *fileName, UINT64 interval, UINT32 preds,
+		 const char * const *predNames);
+  ~INTERVAL_STATS();
+
+  void    Start(UINT64 numInst, UINT64 numCondBranch);
+  bool    Due(UINT64 numInst){ return numInst >= nextBoundary; }
+  void    Sample(UINT64 numInst, UINT64 numCondBranch, const UINT64 *numMispred);
+  void    Finish(UINT64 numInst, UINT64 numCondBranch, const UINT64 *numMispred);
+};
+
+
+/////////////////////////////////////////////////////////////
+// SMARTS style sampling: short measured windows spread over the trace,
+// the predictors trained in between. Each window gives one MPKI sample
+// per predictor; the mean of the samples estimates the MPKI of the
+// whole run, with a confidence interval from their variance.
+/////////////////////////////////////////////////////////////
+
+#define DEFAULT_SAMPLE_PERIODS    100     // period in windows if not given
+#define DEFAULT_SAMPLE_ERROR      2.0     // target relative error in %
+#define SAMPLE_MIN_WINDOWS        30      // before the interval is trusted
+#define SAMPLE_CONFIDENCE_Z       1.96    // 95% confidence
+#define SAMPLE_CHECK_WINDOWS      10      // windows between convergence tests
+#define DEFAULT_SAMPLE_WARM_WINDOWS 10    // gap trained before a window, in windows
+#define SAMPLE_WARM_ALL           ((UINT64)-1)  // train on the whole gap
+
+class SAMPLE_STATS{
+
+ private:
+  UINT32  numPreds;
+  UINT64  numSamples;
+  UINT64  sampledInst;
+  UINT64  sampledCondBranch;
+  UINT64 *sampledMispred;
+
+  double *meanMpki;       // running mean and squared deviations (Welford)
+  double *sqDevMpki;
+
+ public:
+  SAMPLE_STATS(UINT32 preds);
+  ~SAMPLE_STATS();
+
+  void    AddSample(UINT64 numInst, UINT64 numCondBranch, const UINT64 *numMispred);
+  bool    Converged(double targetError);
+
+  UINT64  GetNumSamples(){ return numSamples; }
+  double  GetMpki(UINT32 pred){ return meanMpki[pred]; }
+  double  GetHalfWidth(UINT32 pred);
+  void    PrintStats(const char * const *predNames);
+};
+
+
+/***********************************************************/
+#endif
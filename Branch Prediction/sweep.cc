@@ -0,0 +1,372 @@
+/////////////////////////////////////////////////////////////////////////////////
+// sweep: decode a trace once, then evaluate a grid of predictor
+// configurations on a pool of threads. Every worker owns its PREDICTOR
+// and reads the shared in-memory COND_TRACE. Bimodal and gshare points
+// are batched up to -lanes at a time into one LANE_PREDICTORS pass.
+//
+// build: g++ -std=c++17 -O2 -pthread -o sweep sweep.cc predictor.cc tage.cc perceptron.cc lanes.cc tracer.cc -lz
+/////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include "utils.h"
+#include "tracer.h"
+#include "predictor.h"
+#include "lanes.h"
+
+#define MAX_SWEEP_VALUES   64
+#define MAX_SWEEP_CONFIGS  4096
+
+UINT32 PRED_TYPE=0;
+
+// usage: sweep [-option <values>] <trace>
+//
+// <values> is a comma separated list of numbers and inclusive ranges,
+// e.g. -hist 4:24 or -logentries 10,12,14:16. The grid is the cross
+// product of all options; parameters a predictor type does not use are
+// dropped (NormalizePredictorConfig), so no configuration is simulated
+// twice. Every option is a PREDICTOR_CONFIG field listed in sweepAxes.
+
+/////////////////////////////////////////////////////////////
+// One grid axis per PREDICTOR_CONFIG field
+/////////////////////////////////////////////////////////////
+
+typedef struct {
+  const char *option;
+  const char *column;
+  const char *help;
+  UINT32 PREDICTOR_CONFIG::*field;
+} SWEEP_AXIS;
+
+static const SWEEP_AXIS sweepAxes[] = {
+  { "-types",      "PREDICTOR", "Predictor types",                          &PREDICTOR_CONFIG::type            },
+  { "-hist",       "HIST",      "Global history length in bits",            &PREDICTOR_CONFIG::histLen         },
+  { "-logentries", "LOGENT",    "Log2 entries of PC indexed tables",        &PREDICTOR_CONFIG::logTableEntries },
+  { "-ctrbits",    "CTR",       "Saturating counter width in bits",         &PREDICTOR_CONFIG::ctrBits         },
+  { "-pcbits",     "PCBITS",    "PC bits hashed into the gshare/gselect index", &PREDICTOR_CONFIG::pcBits      },
+  { "-tagetables", "TTABLES",   "TAGE tagged tables",                       &PREDICTOR_CONFIG::tageTables      },
+  { "-tagelogentries", "TLOGENT", "Log2 entries per TAGE tagged table",     &PREDICTOR_CONFIG::tageLogEntries  },
+  { "-tagetagbits", "TTAG",     "TAGE tag width in bits",                   &PREDICTOR_CONFIG::tageTagBits     },
+  { "-tageminhist", "TMINH",    "History of the shortest TAGE table",       &PREDICTOR_CONFIG::tageMinHist     },
+  { "-tagemaxhist", "TMAXH",    "History of the longest TAGE table",        &PREDICTOR_CONFIG::tageMaxHist     },
+  { "-perchist",   "PHIST",     "Perceptron history length",                &PREDICTOR_CONFIG::percHist        },
+  { "-perclogrows", "PROWS",    "Log2 weight vectors per perceptron table", &PREDICTOR_CONFIG::percLogRows     },
+  { "-perctables", "PTABLES",   "Perceptron tables (history segments)",     &PREDICTOR_CONFIG::percTables      },
+  { "-bhtlogentries", "BHT",    "Log2 local history registers of PAG/PAP",  &PREDICTOR_CONFIG::bhtLogEntries   },
+  { "-localhist",  "LHIST",     "PAG/PAP local history length",             &PREDICTOR_CONFIG::localHistLen    },
+};
+
+#define NUM_SWEEP_AXES  (sizeof(sweepAxes)/sizeof(sweepAxes[0]))
+
+void DieUsage(char *prog){
+  PREDICTOR_CONFIG defaults;
+
+  printf("usage: %s [-option <values>] <trace>\n", prog);
+  printf("       <values> is a list such as 4:24 or 10,12,16\n");
+  printf("   Options\n");
+  for(UINT32 aa=0; aa< NUM_SWEEP_AXES; aa++){
+    const SWEEP_AXIS *axis = &sweepAxes[aa];
+    if(axis->field == &PREDICTOR_CONFIG::type){
+      printf("      %-12s <values>  %s (Default: all)\n", axis->option, axis->help);
+    }else{
+      printf("      %-12s <values>  %s (Default: %u)\n", axis->option, axis->help,
+	     defaults.*axis->field);
+    }
+  }
+  printf("      -threads     <num>     Worker threads (Default: all cores)\n");
+  printf("      -traceserver <socket>  Map the trace decoded by traceserver (Default: off)\n");
+  printf("      -lanes       <num>     Bimodal/gshare points per lane pass, 1 for none (Default: %d, %s)\n",
+	 MAX_LANES, LaneSimdName());
+  exit(-1);
+}
+
+UINT32 ParseValues(char *arg, UINT32 *vals, char *prog){
+  UINT32 numVals=0;
+
+  for(char *tok=strtok(arg, ","); tok != NULL; tok=strtok(NULL, ",")){
+    UINT32 lo = atoi(tok);
+    UINT32 hi = lo;
+    char  *colon = strchr(tok, ':');
+
+    if(colon != NULL){
+      hi = atoi(colon+1);
+    }
+    if(hi < lo){
+      printf("Invalid range %s\n", tok);
+      DieUsage(prog);
+    }
+
+    for(UINT32 val=lo; val<= hi; val++){
+      if(numVals == MAX_SWEEP_VALUES){
+	printf("At most %d values per option\n", MAX_SWEEP_VALUES);
+	exit(-1);
+      }
+      vals[numVals++]=val;
+    }
+  }
+
+  return numVals;
+}
+
+bool SameConfig(const PREDICTOR_CONFIG &a, const PREDICTOR_CONFIG &b){
+  for(UINT32 aa=0; aa< NUM_SWEEP_AXES; aa++){
+    if(a.*sweepAxes[aa].field != b.*sweepAxes[aa].field){
+      return false;
+    }
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+typedef struct {
+  PREDICTOR_CONFIG config;
+  UINT64           storageBytes;
+  UINT64           numMispred;
+} SWEEP_POINT;
+
+// one unit of work: a single point, or several simulated in lanes
+typedef struct {
+  UINT32 numPoints;
+  UINT32 points[MAX_LANES];
+} SWEEP_JOB;
+
+void SweepWorker(COND_TRACE *trace, SWEEP_POINT *points, SWEEP_JOB *jobs, UINT32 numJobs,
+		 std::atomic<UINT32> *nextJob){
+
+  for(UINT32 jj=(*nextJob)++; jj< numJobs; jj=(*nextJob)++){
+    SWEEP_JOB *job = &jobs[jj];
+
+    if(job->numPoints == 1){
+      SWEEP_POINT *pt = &points[job->points[0]];
+      PREDICTOR *brpred = new PREDICTOR(pt->config);
+
+      pt->numMispred   = brpred->SimulateBranches(trace->records, trace->numRecords);
+      pt->storageBytes = brpred->GetStorageBytes();
+
+      delete brpred;
+      continue;
+    }
+
+    PREDICTOR_CONFIG configs[MAX_LANES];
+    for(UINT32 ll=0; ll< job->numPoints; ll++){
+      configs[ll] = points[job->points[ll]].config;
+    }
+
+    LANE_PREDICTORS *lanes = new LANE_PREDICTORS(configs, job->numPoints);
+    lanes->Simulate(trace->records, trace->numRecords);
+
+    for(UINT32 ll=0; ll< job->numPoints; ll++){
+      SWEEP_POINT *pt = &points[job->points[ll]];
+      PREDICTOR *brpred = new PREDICTOR(pt->config);   // for its storage only
+
+      pt->numMispred   = lanes->GetNumMispred(ll);
+      pt->storageBytes = brpred->GetStorageBytes();
+
+      delete brpred;
+    }
+    delete lanes;
+  }
+
+}
+
+int main(int argc, char* argv[]){
+
+  PREDICTOR_CONFIG defaults;
+  UINT32 axisVals[NUM_SWEEP_AXES][MAX_SWEEP_VALUES];
+  UINT32 numAxisVals[NUM_SWEEP_AXES];
+  UINT32 numThreads=std::thread::hardware_concurrency();
+  UINT32 maxLanes=MAX_LANES;
+  char  *traceName=NULL;
+
+  for(UINT32 aa=0; aa< NUM_SWEEP_AXES; aa++){
+    axisVals[aa][0]  = defaults.*sweepAxes[aa].field;
+    numAxisVals[aa]  = 1;
+    if(sweepAxes[aa].field == &PREDICTOR_CONFIG::type){
+      for(UINT32 ii=0; ii< PRED_TYPE_MAX; ii++){
+	axisVals[aa][ii]=ii;
+      }
+      numAxisVals[aa] = PRED_TYPE_MAX;
+    }
+  }
+
+  for(int ii=1; ii< argc; ii++){
+    if(argv[ii][0] == '-'){
+      UINT32 aa;
+
+      if(ii == argc-1 || !strcmp(argv[ii], "-h") || !strcmp(argv[ii], "-help")){
+	DieUsage(argv[0]);
+      }
+      if(!strcmp(argv[ii], "-threads")){
+	numThreads = atoi(argv[++ii]);
+	continue;
+      }
+      if(!strcmp(argv[ii], "-lanes")){
+	maxLanes = atoi(argv[++ii]);
+	continue;
+      }
+      if(!strcmp(argv[ii], "-traceserver")){
+	CBP_TRACER::SetTraceServer(argv[++ii]);
+	continue;
+      }
+
+      for(aa=0; aa< NUM_SWEEP_AXES && strcmp(argv[ii], sweepAxes[aa].option); aa++);
+      if(aa == NUM_SWEEP_AXES){
+	printf("Invalid option %s\n", argv[ii]);
+	DieUsage(argv[0]);
+      }
+      numAxisVals[aa] = ParseValues(argv[++ii], axisVals[aa], argv[0]);
+      if(numAxisVals[aa] == 0){
+	printf("No values for %s\n", sweepAxes[aa].option);
+	DieUsage(argv[0]);
+      }
+    }
+    else if(traceName == NULL){
+      traceName = argv[ii];
+    }
+    else{
+      DieUsage(argv[0]);
+    }
+  }
+
+  if(traceName == NULL){
+    DieUsage(argv[0]);
+  }
+  if(numThreads == 0){
+    numThreads = 1;
+  }
+  if(maxLanes == 0 || maxLanes > MAX_LANES){
+    printf("-lanes must be 1 to %d\n", MAX_LANES);
+    exit(-1);
+  }
+
+  ///////////////////////////////////////////////
+  // build the grid, last axis varying fastest
+  ///////////////////////////////////////////////
+
+  SWEEP_POINT *points = new SWEEP_POINT[MAX_SWEEP_CONFIGS];
+  UINT32       numPoints = 0;
+  UINT64       numCombos = 1;
+
+  for(UINT32 aa=0; aa< NUM_SWEEP_AXES; aa++){
+    numCombos *= numAxisVals[aa];
+  }
+
+  for(UINT64 combo=0; combo< numCombos; combo++){
+    PREDICTOR_CONFIG cfg;
+    UINT64 rest = combo;
+
+    for(INT32 aa=NUM_SWEEP_AXES-1; aa>= 0; aa--){
+      cfg.*sweepAxes[aa].field = axisVals[aa][rest % numAxisVals[aa]];
+      rest /= numAxisVals[aa];
+    }
+    NormalizePredictorConfig(&cfg);
+    CheckPredictorConfig(cfg);
+
+    bool seen=false;
+    for(UINT32 ii=0; ii< numPoints && !seen; ii++){
+      seen = SameConfig(points[ii].config, cfg);
+    }
+    if(seen){
+      continue;
+    }
+
+    if(numPoints == MAX_SWEEP_CONFIGS){
+      printf("At most %d configurations per sweep\n", MAX_SWEEP_CONFIGS);
+      exit(-1);
+    }
+    points[numPoints].config     = cfg;
+    points[numPoints].numMispred = 0;
+    numPoints++;
+  }
+
+  ///////////////////////////////////////////////
+  // group the points lanes can run, spread over the threads, and give
+  // every other point a job of its own
+  ///////////////////////////////////////////////
+
+  SWEEP_JOB *jobs = new SWEEP_JOB[numPoints];
+  UINT32     numJobs = 0;
+  UINT32     numLanePoints = 0;
+
+  for(UINT32 ii=0; ii< numPoints; ii++){
+    numLanePoints += LANE_PREDICTORS::CanRun(points[ii].config);
+  }
+
+  UINT32 groupSize = (numLanePoints + numThreads-1) / numThreads;
+  if(groupSize > maxLanes){
+    groupSize = maxLanes;
+  }
+
+  SWEEP_JOB *group = NULL;
+  UINT32     groupBytes = 0;
+
+  for(UINT32 ii=0; ii< numPoints; ii++){
+    const PREDICTOR_CONFIG &cfg = points[ii].config;
+
+    if(groupSize < 2 || !LANE_PREDICTORS::CanRun(cfg)){
+      jobs[numJobs].numPoints = 1;
+      jobs[numJobs].points[0] = ii;
+      numJobs++;
+      continue;
+    }
+
+    UINT32 tableBytes = LANE_PREDICTORS::GetTableBytes(cfg);
+    if(group == NULL || group->numPoints == groupSize ||
+       tableBytes > LANE_MAX_BYTES - groupBytes){
+      group = &jobs[numJobs++];
+      group->numPoints = 0;
+      groupBytes       = 0;
+    }
+    group->points[group->numPoints++] = ii;
+    groupBytes += tableBytes;
+  }
+
+  ///////////////////////////////////////////////
+  // decode once, then simulate the grid in parallel
+  ///////////////////////////////////////////////
+
+  COND_TRACE *trace = new COND_TRACE(traceName);
+
+  std::atomic<UINT32> nextJob(0);
+  std::thread        *workers = new std::thread[numThreads];
+
+  for(UINT32 ii=0; ii< numThreads; ii++){
+    workers[ii] = std::thread(SweepWorker, trace, points, jobs, numJobs, &nextJob);
+  }
+  for(UINT32 ii=0; ii< numThreads; ii++){
+    workers[ii].join();
+  }
+
+  ///////////////////////////////////////////
+  //print_stats
+  ///////////////////////////////////////////
+
+  printf("\n");
+  printf("\nNUM_INSTRUCTIONS     \t : %10llu",   trace->numInst);
+  printf("\nNUM_CONDITIONAL_BR   \t : %10llu",   trace->numRecords);
+  printf("\nNUM_CONFIGS          \t : %10u",     numPoints);
+
+  printf("\n\n%-16s", sweepAxes[0].column);
+  for(UINT32 aa=1; aa< NUM_SWEEP_AXES; aa++){
+    printf(" %7s", sweepAxes[aa].column);
+  }
+  printf(" %12s %12s %12s %12s", "STORAGE(B)", "MISPRED", "MPKI", "CORRECT(%)");
+
+  for(UINT32 ii=0; ii< numPoints; ii++){
+    SWEEP_POINT *pt = &points[ii];
+
+    printf("\n%-16s", PredTypeName(pt->config.type));
+    for(UINT32 aa=1; aa< NUM_SWEEP_AXES; aa++){
+      printf(" %7u", pt->config.*sweepAxes[aa].field);
+    }
+    printf(" %12llu %12llu %12.3f %12.3f", pt->storageBytes, pt->numMispred,
+	   1000.0*(double)(pt->numMispred)/(double)(trace->numInst),
+	   100.0-100.0*(double)(pt->numMispred)/(double)(trace->numRecords));
+  }
+  printf("\n\n");
+
+  return 0;
+}
@@ -0,0 +1,234 @@
+
+
+#include <math.h>
+#include "tage.h"
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+TAGE::TAGE(UINT32 logBaseEntries, UINT32 tables, UINT32 logTableEntries,
+	   UINT32 tagWidth, UINT32 minHist, UINT32 maxHist){
+
+  numTables  = tables;
+  logEntries = logTableEntries;
+  tagBits    = tagWidth;
+
+  base     = new COUNTER_TABLE(1<<logBaseEntries, 2, 2);
+  baseMask = (1<<logBaseEntries)-1;
+
+  // geometric series of history lengths from minHist to maxHist
+  for(UINT32 ii=0; ii< numTables; ii++){
+    double ratio = (numTables == 1) ? 0.0 : (double)ii/(double)(numTables-1);
+    histLength[ii] = (UINT32)(minHist*pow((double)maxHist/(double)minHist, ratio) + 0.5);
+  }
+
+  hist = new GLOBAL_HISTORY(maxHist);
+
+  for(UINT32 ii=0; ii< numTables; ii++){
+    table[ii] = new TAGE_ENTRY[1<<logEntries];
+    for(UINT32 jj=0; jj< (1u<<logEntries); jj++){
+      table[ii][jj].ctr = 0;
+      table[ii][jj].u   = 0;
+      table[ii][jj].tag = 0;
+    }
+
+    indexFold[ii].Init(histLength[ii], logEntries);
+    tagFold[ii][0].Init(histLength[ii], tagBits);
+    tagFold[ii][1].Init(histLength[ii], tagBits-1 ? tagBits-1 : 1);
+  }
+
+  ResetStats();
+
+  useAltOnNewAlloc = (TAGE_ALT_MAX+1)/2;
+  numUpdates       = 0;
+  randState        = 0x2545f491;
+  provider         = -1;
+  alt              = -1;
+}
+
+TAGE::~TAGE(){
+  delete base;
+  delete hist;
+  for(UINT32 ii=0; ii< numTables; ii++){
+    delete [] table[ii];
+  }
+}
+
+/////////////////////////////////////////////////////////////
+// Find the longest (provider) and next longest (alternate) tag hits.
+/////////////////////////////////////////////////////////////
+
+bool   TAGE::GetPrediction(UINT32 PC){
+  UINT32 indexMask = (1<<logEntries)-1;
+  UINT32 tagMask   = (1<<tagBits)-1;
+
+  for(UINT32 ii=0; ii< numTables; ii++){
+    index[ii] = (PC ^ (PC >> logEntries) ^ indexFold[ii].Get()) & indexMask;
+    tag[ii]   = (PC ^ tagFold[ii][0].Get() ^ (tagFold[ii][1].Get() << 1)) & tagMask;
+  }
+
+  provider = -1;
+  alt      = -1;
+  for(INT32 ii=numTables-1; ii>= 0; ii--){
+    if(table[ii][index[ii]].tag == tag[ii]){
+      if(provider < 0){
+	provider = ii;
+      }else{
+	alt = ii;
+	break;
+      }
+    }
+  }
+
+  bool basePred = base->IsTaken(PC & baseMask);
+
+  altPred = (alt >= 0) ? (table[alt][index[alt]].ctr >= 0) : basePred;
+
+  if(provider < 0){
+    newAlloc = false;
+    pred     = basePred;
+    return pred;
+  }
+
+  TAGE_ENTRY *entry = &table[provider][index[provider]];
+
+  providerPred = (entry->ctr >= 0);
+  newAlloc     = (entry->ctr == 0 || entry->ctr == -1) && entry->u == 0;
+
+  // a freshly allocated entry is often worse than the alternate
+  if(newAlloc && useAltOnNewAlloc > TAGE_ALT_MAX/2){
+    pred = altPred;
+  }else{
+    pred = providerPred;
+  }
+
+  return pred;
+}
+
+/////////////////////////////////////////////////////////////
+// Train on the lookup made by the preceding GetPrediction(PC).
+/////////////////////////////////////////////////////////////
+
+void  TAGE::Update(UINT32 PC, bool resolveDir){
+
+  statProvided[provider+1]++;
+
+  if(provider >= 0){
+    TAGE_ENTRY *entry = &table[provider][index[provider]];
+
+    if(newAlloc && providerPred != altPred){
+      if(altPred == resolveDir){
+	useAltOnNewAlloc = SatIncrement(useAltOnNewAlloc, TAGE_ALT_MAX);
+      }else{
+	useAltOnNewAlloc = SatDecrement(useAltOnNewAlloc);
+      }
+    }
+
+    // an entry that is not yet useful also trains the alternate
+    if(entry->u == 0){
+      if(alt >= 0){
+	INT8 *ctr = &table[alt][index[alt]].ctr;
+	if(resolveDir && *ctr < TAGE_CTR_MAX)  (*ctr)++;
+	if(!resolveDir && *ctr > TAGE_CTR_MIN) (*ctr)--;
+      }else{
+	base->PredictAndUpdate(PC & baseMask, resolveDir);
+      }
+    }
+
+    if(resolveDir && entry->ctr < TAGE_CTR_MAX)  entry->ctr++;
+    if(!resolveDir && entry->ctr > TAGE_CTR_MIN) entry->ctr--;
+
+    if(providerPred != altPred){
+      if(providerPred == resolveDir){
+	entry->u = SatIncrement(entry->u, TAGE_U_MAX);
+      }else{
+	entry->u = SatDecrement(entry->u);
+      }
+    }
+  }else{
+    base->PredictAndUpdate(PC & baseMask, resolveDir);
+  }
+
+  if(pred != resolveDir && provider < (INT32)numTables-1){
+    Allocate(resolveDir);
+  }
+
+  // graceful aging of the useful bits
+  numUpdates++;
+  if((numUpdates & ((1<<TAGE_U_RESET_LOG)-1)) == 0){
+    for(UINT32 ii=0; ii< numTables; ii++){
+      for(UINT32 jj=0; jj< (1u<<logEntries); jj++){
+	table[ii][jj].u >>= 1;
+      }
+    }
+  }
+
+  hist->Push(resolveDir);
+  for(UINT32 ii=0; ii< numTables; ii++){
+    indexFold[ii].Update(resolveDir, hist);
+    tagFold[ii][0].Update(resolveDir, hist);
+    tagFold[ii][1].Update(resolveDir, hist);
+  }
+
+}
+
+/////////////////////////////////////////////////////////////
+// On a misprediction take one entry with u==0 in a longer table,
+// starting one table further half of the time to spread allocations.
+// If every candidate is useful, age them instead.
+/////////////////////////////////////////////////////////////
+
+void  TAGE::Allocate(bool resolveDir){
+  UINT32 start = provider+1;
+
+  if(start < numTables-1 && (NextRandom() & 1)){
+    start++;
+  }
+
+  for(UINT32 ii=start; ii< numTables; ii++){
+    TAGE_ENTRY *entry = &table[ii][index[ii]];
+    if(entry->u == 0){
+      entry->tag = tag[ii];
+      entry->ctr = resolveDir ? 0 : -1;
+      return;
+    }
+  }
+
+  for(UINT32 ii=provider+1; ii< numTables; ii++){
+    TAGE_ENTRY *entry = &table[ii][index[ii]];
+    entry->u = SatDecrement(entry->u);
+  }
+}
+
+UINT32 TAGE::NextRandom(){
+  // xorshift32
+  randState ^= randState << 13;
+  randState ^= randState >> 17;
+  randState ^= randState << 5;
+  return randState;
+}
+
+/////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////
+
+UINT64 TAGE::GetStorageBytes(){
+  UINT64 entryBits = 3 + 2 + tagBits;  // ctr, u, tag as modeled
+
+  return base->GetNumBytes() + (numTables*(1ull<<logEntries)*entryBits + 7)/8;
+}
+
+void   TAGE::ResetStats(){
+  for(UINT32 ii=0; ii<= numTables; ii++){
+    statProvided[ii] = 0;
+  }
+}
+
+void   TAGE::PrintStats(){
+
+  printf("\nTAGE_PROVIDER_BASE   \t : %10llu",   statProvided[0]);
+  for(UINT32 ii=0; ii< numTables; ii++){
+    printf("\nTAGE_PROVIDER_T%-2u    \t : %10llu  (hist %u)", ii+1,
+	   statProvided[ii+1], histLength[ii]);
+  }
+
+}
@@ -0,0 +1,87 @@
+#ifndef _TAGE_H_
+#define _TAGE_H_
+
+#include "utils.h"
+#include "counters.h"
+#include "history.h"
+
+/////////////////////////////////////////////////////////////
+// TAGE: a bimodal base table plus tagged tables indexed with
+// geometrically longer global histories. Indices and tags come from
+// folded histories, so a branch costs O(tables), not O(history length).
+/////////////////////////////////////////////////////////////
+
+#define MAX_TAGE_TABLES     16
+#define MAX_TAGE_TAG_BITS   16
+#define MAX_TAGE_HIST       2048
+
+#define TAGE_CTR_MAX        3       // signed 3 bit prediction counter
+#define TAGE_CTR_MIN        (-4)
+#define TAGE_U_MAX          3       // 2 bit useful counter
+#define TAGE_ALT_MAX        15      // 4 bit use-alt-on-newly-allocated
+#define TAGE_U_RESET_LOG    18      // age useful bits every 2^18 branches
+
+typedef struct {
+  INT8    ctr;
+  UINT8   u;
+  UINT16  tag;
+} TAGE_ENTRY;
+
+class TAGE{
+
+ private:
+  UINT32  numTables;
+  UINT32  logEntries;
+  UINT32  tagBits;
+  UINT32  histLength[MAX_TAGE_TABLES];
+
+  COUNTER_TABLE  *base;
+  UINT32          baseMask;
+  TAGE_ENTRY     *table[MAX_TAGE_TABLES];
+
+  GLOBAL_HISTORY *hist;
+  FOLDED_HISTORY  indexFold[MAX_TAGE_TABLES];
+  FOLDED_HISTORY  tagFold[MAX_TAGE_TABLES][2];
+
+  UINT32  useAltOnNewAlloc;
+  UINT64  numUpdates;
+  UINT32  randState;
+
+  // lookup state of the last GetPrediction, reused by Update
+  UINT32  index[MAX_TAGE_TABLES];
+  UINT32  tag[MAX_TAGE_TABLES];
+  INT32   provider;       // -1: the base table provides
+  INT32   alt;
+  bool    providerPred;
+  bool    altPred;
+  bool    newAlloc;       // provider entry is weak and not yet useful
+  bool    pred;
+
+  // stats
+  UINT64  statProvided[MAX_TAGE_TABLES+1];   // [0] is the base table
+
+ public:
+  TAGE(UINT32 logBaseEntries, UINT32 tables, UINT32 logTableEntries,
+       UINT32 tagWidth, UINT32 minHist, UINT32 maxHist);
+  ~TAGE();
+
+  bool    GetPrediction(UINT32 PC);
+  void    Update(UINT32 PC, bool resolveDir);
+  bool    PredictAndUpdate(UINT32 PC, bool resolveDir){
+    bool predDir = GetPrediction(PC);
+    Update(PC, resolveDir);
+    return predDir;
+  }
+
+  UINT64  GetStorageBytes();
+  void    ResetStats();
+  void    PrintStats();
+
+ private:
+  void    Allocate(bool resolveDir);
+  UINT32  NextRandom();
+};
+
+
+/***********************************************************/
+#endif
@@ -0,0 +1,181 @@
+/////////////////////////////////////////////////////////////////////////////////
+// tracepack: convert a CBP trace once into one of the formats that
+// CBP_TRACER maps directly (see TRACE_FILE_HEADER in tracer.h).
+//
+// build: g++ -std=c++17 -O2 -pthread -o tracepack tracepack.cc tracer.cc -lz
+/////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "utils.h"
+#include "tracer.h"
+
+// usage: tracepack [-c|-z] <trace> <packed trace>
+//
+// -c keeps only conditional branches (PC, direction, instruction gap)
+// -z writes a chunked trace, compressed but seekable
+
+void WriteCondOnly(CBP_TRACER *tracer, FILE *outFile, TRACE_FILE_HEADER *header){
+
+  COND_TRACE_RECORD *block = new COND_TRACE_RECORD[TRACE_BLOCK_RECORDS];
+  const CBP_TRACE_RECORD *rec;
+  UINT32 numInBlock = 0;
+  UINT64 lastBranchInst = 0;
+
+  while ((rec = tracer->NextRecord()) != NULL) {
+
+    if(rec->opType != OPTYPE_BRANCH_COND){
+      continue;
+    }
+
+    UINT64 gap = tracer->GetNumInst() - lastBranchInst;
+    if(gap > COND_TRACE_MAX_GAP){
+      printf("More than %u instructions between conditional branches. Dying\n",
+	     COND_TRACE_MAX_GAP);
+      exit(-1);
+    }
+    lastBranchInst = tracer->GetNumInst();
+
+    COND_TRACE_RECORD *out = &block[numInBlock++];
+    out->PC     = rec->PC;
+    out->gapDir = ((UINT32)gap << 1) | (rec->branchTaken ? 1 : 0);
+
+    if(numInBlock == TRACE_BLOCK_RECORDS){
+      fwrite(block, sizeof(COND_TRACE_RECORD), numInBlock, outFile);
+      numInBlock = 0;
+    }
+  }
+  fwrite(block, sizeof(COND_TRACE_RECORD), numInBlock, outFile);
+
+  header->recordBytes = sizeof(COND_TRACE_RECORD);
+  header->numRecords  = tracer->GetNumCondBranch();
+  header->numInst     = tracer->GetNumInst();
+
+  delete [] block;
+}
+
+void WriteChunked(CBP_TRACER *tracer, FILE *outFile, TRACE_FILE_HEADER *header){
+
+  UINT32 rawCapacity = TRACE_BLOCK_RECORDS*TRACE_RECORD_BYTES;
+  UINT8 *raw     = new UINT8[rawCapacity];
+  uLong  compCapacity = compressBound(rawCapacity);
+  UINT8 *comp    = new UINT8[compCapacity];
+  UINT64 capacity = 1024;
+  CHUNK_INDEX_ENTRY *index = (CHUNK_INDEX_ENTRY *)malloc(capacity*sizeof(CHUNK_INDEX_ENTRY));
+  UINT64 numChunks = 0;
+  UINT64 offset    = sizeof(TRACE_FILE_HEADER);
+  UINT32 numInBlock = 0;
+  const CBP_TRACE_RECORD *rec;
+
+  for(;;){
+    rec = tracer->NextRecord();
+
+    if(rec != NULL){
+      UINT8 *out = raw + numInBlock*TRACE_RECORD_BYTES;
+
+      memcpy(out,   &rec->PC,           4);
+      memcpy(out+4, &rec->branchTarget, 4);
+      out[8] = (UINT8)rec->opType;
+      out[9] = rec->branchTaken;
+      numInBlock++;
+    }
+
+    if(numInBlock == TRACE_BLOCK_RECORDS || (rec == NULL && numInBlock > 0)){
+      uLongf compBytes = compCapacity;
+
+      if(compress2(comp, &compBytes, raw, numInBlock*TRACE_RECORD_BYTES, Z_DEFAULT_COMPRESSION) != Z_OK){
+	printf("Unable to compress the trace. Dying\n");
+	exit(-1);
+      }
+
+      if(numChunks == capacity){
+	capacity *= 2;
+	index     = (CHUNK_INDEX_ENTRY *)realloc(index, capacity*sizeof(CHUNK_INDEX_ENTRY));
+      }
+      index[numChunks].offset    = offset;
+      index[numChunks].firstInst = tracer->GetNumInst() - numInBlock;
+      index[numChunks].compBytes = compBytes;
+      index[numChunks].numRecs   = numInBlock;
+      numChunks++;
+
+      fwrite(comp, 1, compBytes, outFile);
+      offset    += compBytes;
+      numInBlock = 0;
+    }
+
+    if(rec == NULL){
+      break;
+    }
+  }
+  fwrite(index, sizeof(CHUNK_INDEX_ENTRY), numChunks, outFile);
+
+  header->recordBytes  = TRACE_RECORD_BYTES;
+  header->chunkRecords = TRACE_BLOCK_RECORDS;
+  header->numRecords   = tracer->GetNumInst();
+  header->numInst      = tracer->GetNumInst();
+
+  free(index);
+  delete [] raw;
+  delete [] comp;
+}
+
+int main(int argc, char* argv[]){
+
+  bool condOnly = (argc == 4 && !strcmp(argv[1], "-c"));
+  bool chunked  = (argc == 4 && !strcmp(argv[1], "-z"));
+
+  if (argc != 3 && !condOnly && !chunked) {
+    printf("usage: %s [-c|-z] <trace> <packed trace>\n", argv[0]);
+    printf("       -c keeps only conditional branches\n");
+    printf("       -z writes a chunked trace, compressed but seekable\n");
+    exit(-1);
+  }
+
+  char *inName  = argv[argc-2];
+  char *outName = argv[argc-1];
+
+  CBP_TRACER *tracer = new CBP_TRACER(inName, true);
+  FILE       *outFile;
+
+  if (tracer->IsCondOnly() && !condOnly){
+    printf("%s holds only conditional branches; it can not be packed in full\n", inName);
+    exit(-1);
+  }
+
+  if ((outFile = fopen(outName, "wb")) == NULL){
+    printf("Unable to open the output file. Dying\n");
+    exit(-1);
+  }
+
+  TRACE_FILE_HEADER header;
+  bool written = true;
+
+  if(condOnly || chunked){
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, condOnly ? COND_TRACE_MAGIC : CHUNK_TRACE_MAGIC, TRACE_MAGIC_BYTES);
+
+    // counts are filled in once the whole trace has been read
+    fwrite(&header, sizeof(header), 1, outFile);
+
+    if(condOnly){
+      WriteCondOnly(tracer, outFile, &header);
+    }else{
+      WriteChunked(tracer, outFile, &header);
+    }
+
+    fseek(outFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, outFile);
+  }else{
+    // nothing is buffered in outFile yet
+    written = WritePackedTrace(tracer, fileno(outFile), &header);
+  }
+
+  // any failed fwrite above leaves the error flag set
+  if(!written || ferror(outFile) || fclose(outFile) != 0){
+    printf("Error writing the output file. Dying\n");
+    exit(-1);
+  }
+
+  printf("\nWrote %llu records (%llu instructions) to %s\n",
+	 header.numRecords, header.numInst, outName);
+  return 0;
+}
@@ -1,18 +1,149 @@
 
-#include <assert.h>
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <limits.h>
 #include "tracer.h"
 
+const char *CBP_TRACER::traceServer = NULL;
+
 /////////////////////////////////////////
 /////////////////////////////////////////
 
-CBP_TRACER::CBP_TRACER(char *traceFileName){
-  char  cmdString[1024];
-  
-  sprintf(cmdString,"gunzip -c %s", traceFileName);
+// records in the gzip trace layout to CBP_TRACE_RECORDs; FAILURE if one
+// is not a valid record
+static bool ParseRecords(const UINT8 *src, UINT32 numRecs, CBP_TRACE_RECORD *block){
+
+  for(UINT32 ii=0; ii< numRecs; ii++, src+=TRACE_RECORD_BYTES){
+    CBP_TRACE_RECORD *rec = &block[ii];
+
+    memcpy(&rec->PC,           src,   4);
+    memcpy(&rec->branchTarget, src+4, 4);
+    rec->opType      = (OpType)src[8];
+    rec->branchTaken = src[9];
+
+    // sanity check
+    if(rec->opType >= OPTYPE_MAX){
+      return FAILURE;
+    }
+  }
+  return SUCCESS;
+}
+
+// Ask the trace server at socketName for traceFileName; returns the
+// descriptor of its packed image
+static int RequestTrace(const char *socketName, const char *traceFileName){
+  struct sockaddr_un addr;
+  char   path[PATH_MAX];
+
+  if(realpath(traceFileName, path) == NULL){
+    printf("Unable to open the trace file. Dying\n");
+    exit(-1);
+  }
+
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socketName, sizeof(addr.sun_path)-1);
+
+  if(sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+    printf("Unable to reach the trace server %s. Dying\n", socketName);
+    exit(-1);
+  }
+  if(write(sock, path, strlen(path)+1) != (ssize_t)(strlen(path)+1)){
+    printf("Unable to send the request to the trace server. Dying\n");
+    exit(-1);
+  }
+
+  TRACE_SERVER_REPLY reply;
+  char   control[CMSG_SPACE(sizeof(int))];
+  struct iovec  iov = { &reply, sizeof(reply) };
+  struct msghdr msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control;
+  msg.msg_controllen = sizeof(control);
 
-  if ((traceFile = popen(cmdString, "r")) == NULL){
-   printf("Unable to open the trace file. Dying\n");
-   exit(-1);
+  ssize_t got = recvmsg(sock, &msg, MSG_WAITALL);
+  close(sock);
+
+  if(got != sizeof(reply)){
+    printf("No reply from the trace server. Dying\n");
+    exit(-1);
+  }
+  if(reply.status != 0){
+    reply.message[TRACE_SERVER_MSG_BYTES-1] = 0;
+    printf("Trace server: %s. Dying\n", reply.message);
+    exit(-1);
+  }
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if(cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS){
+    printf("The trace server sent no trace. Dying\n");
+    exit(-1);
+  }
+
+  int fd;
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+  return fd;
+}
+
+CBP_TRACER::CBP_TRACER(char *traceFileName, bool readAhead){
+
+  traceFile = NULL;
+  condOnly  = false;
+  chunked   = false;
+  traceTotalInst = 0;
+  rawBlock  = NULL;
+  rawLen    = 0;
+  recBlock  = NULL;
+  recCur    = NULL;
+  recEnd    = NULL;
+  mapBase   = NULL;
+  mapBytes  = 0;
+  recBase   = NULL;
+  chunkIndex = NULL;
+  numChunks  = 0;
+  nextChunk  = 0;
+  condCur   = NULL;
+  condEnd   = NULL;
+  gapBlock  = NULL;
+  gapCur    = NULL;
+  condTotalInst = 0;
+  ring      = NULL;
+  reader    = NULL;
+  readerStop   = false;
+  readerDone   = false;
+  holdingBatch = false;
+  readError    = NULL;
+
+  if(!OpenPacked(traceFileName)){
+
+    // zlib inflates in-process; plain uncompressed traces are read as is
+    if ((traceFile = gzopen(traceFileName, "rb")) == NULL){
+     printf("Unable to open the trace file. Dying\n");
+     exit(-1);
+    }
+    gzbuffer(traceFile, 1<<18);
+
+    rawBlock = new UINT8[TRACE_BLOCK_RECORDS*TRACE_RECORD_BYTES];
+
+    // on a single core the thread could only take time from the caller
+    if(readAhead && std::thread::hardware_concurrency() > 1){
+      ring   = new SPSC_RING<TRACE_BATCH>();
+      reader = new std::thread(&CBP_TRACER::ReadAhead, this);
+    }else{
+      recBlock = new CBP_TRACE_RECORD[TRACE_BLOCK_RECORDS];
+      recCur   = recBlock;
+      recEnd   = recBlock;
+    }
   }
 
   numInst=0;
@@ -20,54 +151,552 @@ CBP_TRACER::CBP_TRACER(char *traceFileName){
 
 }
 
+CBP_TRACER::~CBP_TRACER(){
+  if(reader != NULL){
+    readerStop = true;
+    reader->join();
+    delete reader;
+    delete ring;
+  }
+  if(traceFile != NULL){
+    gzclose(traceFile);
+  }
+  if(mapBase != NULL){
+    munmap(mapBase, mapBytes);
+  }
+  delete [] rawBlock;
+  delete [] recBlock;
+  delete [] gapBlock;
+}
+
+/////////////////////////////////////////
+// Map a packed, conditional-branch-only or chunked trace (see
+// tracepack.cc). A packed trace is one block, so records are served
+// straight out of the page cache; a conditional-branch-only trace is
+// expanded a block at a time by FillCondBlock and a chunked one is
+// inflated a chunk at a time. Returns FAILURE if the file is none.
+// With a trace server the image it serves is mapped instead of the file;
+// its descriptor is shared with other clients, hence pread.
+/////////////////////////////////////////
+
+bool  CBP_TRACER::OpenPacked(char *traceFileName){
+  TRACE_FILE_HEADER header;
+  struct stat       st;
+
+  int fd = (traceServer != NULL) ? RequestTrace(traceServer, traceFileName) :
+                                   open(traceFileName, O_RDONLY);
+  if(fd < 0){
+    printf("Unable to open the trace file. Dying\n");
+    exit(-1);
+  }
+
+  if(pread(fd, &header, sizeof(header), 0) != sizeof(header)){
+    close(fd);
+    return FAILURE;
+  }
+
+  if(!memcmp(header.magic, COND_TRACE_MAGIC, TRACE_MAGIC_BYTES)){
+    condOnly = true;
+  }else if(!memcmp(header.magic, CHUNK_TRACE_MAGIC, TRACE_MAGIC_BYTES)){
+    chunked = true;
+  }else if(memcmp(header.magic, PACKED_TRACE_MAGIC, TRACE_MAGIC_BYTES)){
+    close(fd);
+    return FAILURE;
+  }
+
+  UINT32 recordBytes = condOnly ? sizeof(COND_TRACE_RECORD) :
+                       chunked  ? TRACE_RECORD_BYTES : sizeof(CBP_TRACE_RECORD);
+
+  if(header.recordBytes != recordBytes){
+    printf("Packed trace was written with %u byte records, expected %u. Dying\n",
+	   header.recordBytes, recordBytes);
+    exit(-1);
+  }
+
+  if(fstat(fd, &st) != 0){
+    printf("Unable to stat the trace file. Dying\n");
+    exit(-1);
+  }
+
+  // compare record counts rather than byte sizes, so a corrupt count
+  // can not wrap around; the pread above saw a whole header
+  UINT64 bodyBytes = (UINT64)st.st_size - sizeof(header);
+  bool   truncated;
+
+  if(chunked){
+    if(header.chunkRecords == 0 || header.chunkRecords > TRACE_BLOCK_RECORDS){
+      printf("Chunked trace has %u records per chunk, at most %u are supported. Dying\n",
+	     header.chunkRecords, TRACE_BLOCK_RECORDS);
+      exit(-1);
+    }
+    numChunks = header.numRecords / header.chunkRecords +
+                (header.numRecords % header.chunkRecords != 0);
+    mapBytes  = st.st_size;   // chunks and index; chunk sizes checked by LoadChunk
+    truncated = numChunks > bodyBytes / sizeof(CHUNK_INDEX_ENTRY);
+  }else{
+    truncated = header.numRecords > bodyBytes / recordBytes;
+    mapBytes  = sizeof(header) + header.numRecords*recordBytes;
+  }
+
+  if(truncated){
+    printf("Packed trace is truncated. Dying\n");
+    exit(-1);
+  }
+
+  mapBase = mmap(NULL, mapBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(mapBase == MAP_FAILED){
+    printf("Unable to map the trace file. Dying\n");
+    exit(-1);
+  }
+  madvise(mapBase, mapBytes, MADV_SEQUENTIAL);
+  traceTotalInst = header.numInst;
+
+  if(condOnly){
+    condCur  = (const COND_TRACE_RECORD *)((UINT8 *)mapBase + sizeof(header));
+    condEnd  = condCur + header.numRecords;
+    condTotalInst = header.numInst;
+
+    recBlock = new CBP_TRACE_RECORD[TRACE_BLOCK_RECORDS];
+    gapBlock = new UINT32[TRACE_BLOCK_RECORDS];
+    recCur   = recBlock;
+    recEnd   = recBlock;
+    gapCur   = gapBlock;
+    return SUCCESS;
+  }
+
+  if(chunked){
+    chunkIndex = (const CHUNK_INDEX_ENTRY *)((UINT8 *)mapBase + mapBytes) - numChunks;
+
+    rawBlock = new UINT8[TRACE_BLOCK_RECORDS*TRACE_RECORD_BYTES];
+    recBlock = new CBP_TRACE_RECORD[TRACE_BLOCK_RECORDS];
+    recCur   = recBlock;
+    recEnd   = recBlock;
+    return SUCCESS;
+  }
+
+  recBase = (const CBP_TRACE_RECORD *)((UINT8 *)mapBase + sizeof(header));
+  recCur  = recBase;
+  recEnd  = recBase + header.numRecords;
+
+  return SUCCESS;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+bool  CBP_TRACER::FillBlock(){
+
+  if(condOnly){
+    return FillCondBlock();
+  }
+
+  if(chunked){
+    if(nextChunk == numChunks){
+      return FAILURE;
+    }
+    LoadChunk(nextChunk++);
+    return SUCCESS;
+  }
+
+  if(traceFile == NULL){
+    return FAILURE; // a packed trace is mapped as a single block
+  }
+
+  if(ring != NULL){
+    return NextBatch();
+  }
+
+  INT32 numRecs = ReadBlock(recBlock);
+
+  if(numRecs == TRACE_READ_ERROR){
+    DieReadError();
+  }
+  recCur = recBlock;
+  recEnd = recBlock+numRecs;
+
+  return (numRecs != 0);
+}
+
+/////////////////////////////////////////
+// Inflate the next block of the trace and parse every complete record
+// in it into block; returns the number of records. A partial record at
+// the end of the block is carried over to the start of the next one.
+// Runs on the read ahead thread, so a failure is only returned
+// (TRACE_READ_ERROR, reason in readError) for the caller to report.
+/////////////////////////////////////////
+
+INT32  CBP_TRACER::ReadBlock(CBP_TRACE_RECORD *block){
+
+  UINT32 capacity = TRACE_BLOCK_RECORDS*TRACE_RECORD_BYTES;
+  int    bytesRead = gzread(traceFile, rawBlock+rawLen, capacity-rawLen);
+
+  if((readError = GzReadError(bytesRead)) != NULL){
+    return TRACE_READ_ERROR;
+  }
+
+  rawLen += bytesRead;
+
+  UINT32 numRecs = rawLen / TRACE_RECORD_BYTES;
+
+  if(!ParseRecords(rawBlock, numRecs, block)){
+    readError = "invalid record";
+    return TRACE_READ_ERROR;
+  }
+
+  // keep the tail of a record split across two reads
+  rawLen -= numRecs*TRACE_RECORD_BYTES;
+  memmove(rawBlock, rawBlock + numRecs*TRACE_RECORD_BYTES, rawLen);
+
+  return numRecs;
+}
+
+// gzread returns the data before a truncated end of the gzip stream,
+// then reports the end as 0 bytes with Z_BUF_ERROR; returns why a read
+// failed, or NULL if it did not
+const char *CBP_TRACER::GzReadError(int bytesRead){
+  int errnum = Z_OK;
+  const char *msg = gzerror(traceFile, &errnum);
+
+  if(bytesRead < 0 || (bytesRead == 0 && errnum == Z_BUF_ERROR)){
+    return msg;
+  }
+  return NULL;
+}
+
+void  CBP_TRACER::DieReadError(){
+  printf("Error reading the trace file: %s. Dying\n", readError);
+  exit(-1);
+}
+
+// inflate a chunk of a chunked trace into recBlock
+void  CBP_TRACER::LoadChunk(UINT64 chunk){
+  const CHUNK_INDEX_ENTRY *entry = &chunkIndex[chunk];
+  uLongf rawBytes = TRACE_BLOCK_RECORDS*TRACE_RECORD_BYTES;
+
+  if(entry->offset > mapBytes || entry->compBytes > mapBytes - entry->offset ||
+     entry->numRecs > TRACE_BLOCK_RECORDS ||
+     uncompress(rawBlock, &rawBytes, (const Bytef *)mapBase + entry->offset, entry->compBytes) != Z_OK ||
+     rawBytes != (uLongf)entry->numRecs*TRACE_RECORD_BYTES ||
+     !ParseRecords(rawBlock, entry->numRecs, recBlock)){
+    printf("Chunk %llu of the trace is corrupt. Dying\n", chunk);
+    exit(-1);
+  }
+
+  recCur = recBlock;
+  recEnd = recBlock+entry->numRecs;
+}
+
 /////////////////////////////////////////
+// Body of the read ahead thread: fill ring slots until the trace ends,
+// it can not be read, or the tracer is destroyed.
 /////////////////////////////////////////
 
-bool  CBP_TRACER::GetNextRecord(CBP_TRACE_RECORD *rec){
+void  CBP_TRACER::ReadAhead(){
+
+  for(;;){
+    TRACE_BATCH *batch = ring->ProducerSlot(readerStop);
+
+    if(batch == NULL){
+      return;
+    }
+
+    INT32 numRecs = ReadBlock(batch->recs);
+
+    batch->numRecs = numRecs;
+    ring->Produce();
+
+    if(numRecs == 0 || numRecs == TRACE_READ_ERROR){
+      return;
+    }
+  }
+}
+
+// hand the current batch back and take the next one from the reader
+bool  CBP_TRACER::NextBatch(){
+
+  if(readerDone){
+    return FAILURE;
+  }
+  if(holdingBatch){
+    ring->Consume();
+  }
+
+  const TRACE_BATCH *batch = ring->ConsumerSlot(readerStop);
+
+  holdingBatch = true;
+  if(batch->numRecs == TRACE_READ_ERROR){
+    DieReadError();
+  }
+  if(batch->numRecs == 0){
+    readerDone = true;
+    return FAILURE;
+  }
+
+  recCur = batch->recs;
+  recEnd = batch->recs+batch->numRecs;
+
+  return SUCCESS;
+}
+
+/////////////////////////////////////////
+// Expand the next block of a conditional-branch-only trace. Once it is
+// exhausted the instruction count is set to the header total, which
+// includes the instructions after the last conditional branch.
+/////////////////////////////////////////
+
+bool  CBP_TRACER::FillCondBlock(){
+
+  UINT32 numRecs = TRACE_BLOCK_RECORDS;
+
+  if((UINT64)(condEnd-condCur) < numRecs){
+    numRecs = condEnd-condCur;
+  }
+
+  if(numRecs == 0){
+    numInst = condTotalInst;
+    return FAILURE;
+  }
+
+  for(UINT32 ii=0; ii< numRecs; ii++, condCur++){
+    CBP_TRACE_RECORD *rec = &recBlock[ii];
+
+    rec->PC           = condCur->PC;
+    rec->opType       = OPTYPE_BRANCH_COND;
+    rec->branchTaken  = condCur->gapDir & 1;
+    rec->branchTarget = 0;
+    gapBlock[ii]      = condCur->gapDir >> 1;
+  }
+
+  recCur = recBlock;
+  recEnd = recBlock+numRecs;
+  gapCur = gapBlock;
+
+  return SUCCESS;
+}
+
+/////////////////////////////////////////
+// Fast forward past the next skipInst instructions without handing the
+// records out: a packed trace just moves its cursor, a chunked trace
+// seeks, a compressed trace is inflated but not parsed (unless the read
+// ahead thread parses it anyway), and a conditional-branch-only trace
+// only sums the gaps (a record is skipped when it ends at or before the
+// target). Skipped records are not counted as conditional branches.
+/////////////////////////////////////////
+
+void  CBP_TRACER::Skip(UINT64 skipInst){
+  UINT64 target = numInst + skipInst;
+
+  if(chunked){
+    Seek(target);
+    return;
+  }
+
+  if(condOnly){
+    while(recCur != recEnd && numInst + *gapCur <= target){
+      numInst += *gapCur++;
+      recCur++;
+    }
+    if(recCur != recEnd){
+      return;
+    }
+    while(condCur != condEnd && numInst + (condCur->gapDir >> 1) <= target){
+      numInst += condCur->gapDir >> 1;
+      condCur++;
+    }
+    return;
+  }
 
-  fread (&rec->PC, 4, 1, traceFile);
-  fread (&rec->branchTarget, 4, 1, traceFile);
-  fread (&rec->opType, 1, 1, traceFile);
-  fread (&rec->branchTaken, 1, 1, traceFile);
+  // records already parsed; for a packed trace that is all of them
+  UINT64 numRecs = target - numInst;
+  if((UINT64)(recEnd-recCur) < numRecs){
+    numRecs = recEnd-recCur;
+  }
+  recCur  += numRecs;
+  numInst += numRecs;
 
-  if(feof(traceFile)){
-    return FAILURE; 
+  if(numInst == target || traceFile == NULL){
+    return;
   }
 
-  // sanity check
-  assert(rec->opType < OPTYPE_MAX);
+  if(ring != NULL){
+    while(numInst < target && FillBlock()){
+      numRecs = target - numInst;
+      if((UINT64)(recEnd-recCur) < numRecs){
+	numRecs = recEnd-recCur;
+      }
+      recCur  += numRecs;
+      numInst += numRecs;
+    }
+    return;
+  }
+
+  // the carried over partial record is the first one dropped
+  UINT32 capacity  = TRACE_BLOCK_RECORDS*TRACE_RECORD_BYTES;
+  UINT64 dropBytes = (target-numInst)*TRACE_RECORD_BYTES - rawLen;
+  UINT64 doneBytes = rawLen;
 
-  // update trace stats and heartbeat
-  numInst++;
-  CheckHeartBeat();
+  while(dropBytes > 0){
+    UINT32 chunk     = (dropBytes < capacity) ? (UINT32)dropBytes : capacity;
+    int    bytesRead = gzread(traceFile, rawBlock, chunk);
 
-  if(rec->opType == OPTYPE_BRANCH_COND){
-    numCondBranch++;
+    if((readError = GzReadError(bytesRead)) != NULL){
+      DieReadError();
+    }
+    if(bytesRead == 0){
+      break;
+    }
+    dropBytes -= bytesRead;
+    doneBytes += bytesRead;
   }
 
-  return SUCCESS; 
+  numInst += doneBytes / TRACE_RECORD_BYTES;
+  rawLen   = 0;
 }
 
 /////////////////////////////////////////
+// Position a packed or chunked trace so the next record is instruction
+// inst (or the end of the trace); returns FAILURE for other formats.
+// The conditional branch count only covers records handed out.
 /////////////////////////////////////////
 
-void CBP_TRACER::CheckHeartBeat(){
-  UINT64 dotInterval=1000000;
-  UINT64 lineInterval=30*dotInterval;
+bool  CBP_TRACER::Seek(UINT64 inst){
 
-  if(numInst-lastHeartBeat >= dotInterval){
-    printf("."); 
-    fflush(stdout);
+  if(!IsSeekable()){
+    return FAILURE;
+  }
+  if(inst > traceTotalInst){
+    inst = traceTotalInst;
+  }
 
-    lastHeartBeat=numInst;
+  if(chunked){
+    UINT64 lo = 0, hi = numChunks;    // last chunk starting at or before inst
 
-    if(numInst % lineInterval == 0){
-      printf("\n");
-      fflush(stdout);
+    while(hi - lo > 1){
+      UINT64 mid = (lo+hi)/2;
+      if(chunkIndex[mid].firstInst <= inst){
+	lo = mid;
+      }else{
+	hi = mid;
+      }
     }
 
+    recCur = recEnd = recBlock;
+    nextChunk = numChunks;
+    if(lo < numChunks && inst < traceTotalInst){
+      LoadChunk(lo);
+      nextChunk = lo+1;
+      recCur   += inst - chunkIndex[lo].firstInst;
+    }
+  }else{
+    recCur = recBase + inst;
   }
 
+  numInst = inst;
+  return SUCCESS;
 }
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+COND_TRACE::COND_TRACE(char *traceFileName){
+  CBP_TRACER *tracer = new CBP_TRACER(traceFileName, true);
+  const CBP_TRACE_RECORD *rec;
+  UINT64 capacity = TRACE_BLOCK_RECORDS;
+  UINT64 lastBranchInst = 0;
+
+  records    = (COND_TRACE_RECORD *)malloc(capacity*sizeof(COND_TRACE_RECORD));
+  numRecords = 0;
+
+  while ((rec = tracer->NextRecord()) != NULL) {
+
+    if(rec->opType != OPTYPE_BRANCH_COND){
+      continue;
+    }
+
+    if(numRecords == capacity){
+      capacity *= 2;
+      records   = (COND_TRACE_RECORD *)realloc(records, capacity*sizeof(COND_TRACE_RECORD));
+      if(records == NULL){
+	printf("Out of memory loading the trace. Dying\n");
+	exit(-1);
+      }
+    }
+
+    UINT64 gap = tracer->GetNumInst() - lastBranchInst;
+    if(gap > COND_TRACE_MAX_GAP){
+      printf("More than %u instructions between conditional branches. Dying\n",
+	     COND_TRACE_MAX_GAP);
+      exit(-1);
+    }
+    lastBranchInst = tracer->GetNumInst();
+
+    records[numRecords].PC     = rec->PC;
+    records[numRecords].gapDir = ((UINT32)gap << 1) | (rec->branchTaken ? 1 : 0);
+    numRecords++;
+  }
+
+  numInst = tracer->GetNumInst();
+  delete tracer;
+}
+
+static bool WriteAll(int fd, const void *buf, size_t len){
+  const UINT8 *src = (const UINT8 *)buf;
+
+  while(len > 0){
+    ssize_t done = write(fd, src, len);
+    if(done <= 0){
+      return FAILURE;
+    }
+    src += done;
+    len -= done;
+  }
+  return SUCCESS;
+}
+
+/////////////////////////////////////////
+// Write the rest of tracer to fd as a packed trace, header first; the
+// header is rewritten at offset 0 once the counts are known and left in
+// header. FAILURE if a write fails.
+/////////////////////////////////////////
+
+bool WritePackedTrace(CBP_TRACER *tracer, int fd, TRACE_FILE_HEADER *header){
+
+  CBP_TRACE_RECORD *block = new CBP_TRACE_RECORD[TRACE_BLOCK_RECORDS];
+  const CBP_TRACE_RECORD *rec;
+  UINT32 numInBlock = 0;
+  bool   ok;
+
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, PACKED_TRACE_MAGIC, TRACE_MAGIC_BYTES);
+  header->recordBytes = sizeof(CBP_TRACE_RECORD);
+
+  // copy records a block at a time, padding zeroed
+  memset((void *)block, 0, TRACE_BLOCK_RECORDS*sizeof(CBP_TRACE_RECORD));
+  ok = WriteAll(fd, header, sizeof(*header));
+
+  while (ok && (rec = tracer->NextRecord()) != NULL) {
+    CBP_TRACE_RECORD *out = &block[numInBlock++];
+
+    out->PC           = rec->PC;
+    out->opType       = rec->opType;
+    out->branchTaken  = rec->branchTaken;
+    out->branchTarget = rec->branchTarget;
+
+    if(numInBlock == TRACE_BLOCK_RECORDS){
+      ok = WriteAll(fd, block, numInBlock*sizeof(CBP_TRACE_RECORD));
+      numInBlock = 0;
+    }
+  }
+  ok = ok && WriteAll(fd, block, numInBlock*sizeof(CBP_TRACE_RECORD));
+
+  header->numRecords = tracer->GetNumInst();
+  header->numInst    = tracer->GetNumInst();
+  ok = ok && pwrite(fd, header, sizeof(*header), 0) == sizeof(*header);
+
+  delete [] block;
+  return ok;
+}
+
 /////////////////////////////////////////
 /////////////////////////////////////////
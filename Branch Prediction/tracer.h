@@ -1,7 +1,9 @@
 #ifndef _TRACER_H_
 #define _TRACER_H_
 
+#include <zlib.h>    // link with -lz
 #include "utils.h"
+#include "ring.h"
 
 /////////////////////////////////////////
 /////////////////////////////////////////
@@ -38,30 +40,226 @@ class CBP_TRACE_RECORD{
 };
 
 
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// On-disk record: PC(4) branchTarget(4) opType(1) branchTaken(1)
+#define TRACE_RECORD_BYTES    10
+
+// Records decoded per call into zlib
+#define TRACE_BLOCK_RECORDS   (1<<16)
+
+// A block of parsed records passed from the read ahead thread; a batch
+// of no records marks the end of the trace, TRACE_READ_ERROR records a
+// trace that could not be read
+#define TRACE_READ_ERROR      (-1)
+
+typedef struct {
+  INT32            numRecs;
+  CBP_TRACE_RECORD recs[TRACE_BLOCK_RECORDS];
+} TRACE_BATCH;
+
+/////////////////////////////////////////
+// Packed trace: a 64 byte header followed by CBP_TRACE_RECORDs exactly
+// as they sit in memory, so the file can be mmap'd and iterated in place.
+// Written by tracepack; only valid on machines with the writer's ABI,
+// which recordBytes guards against.
+/////////////////////////////////////////
+
+#define PACKED_TRACE_MAGIC     "CBPPACK1"
+#define TRACE_MAGIC_BYTES      8
+
+typedef struct {
+  char   magic[TRACE_MAGIC_BYTES];
+  UINT32 recordBytes;            // sizeof(CBP_TRACE_RECORD) of the writer
+  UINT32 chunkRecords;           // records per chunk of a chunked trace, else 0
+  UINT64 numRecords;
+  UINT64 numInst;
+  UINT8  pad[32];                // records start 64 byte aligned
+} TRACE_FILE_HEADER;
+
+/////////////////////////////////////////
+// Conditional-branch-only trace: same header, but each record is just
+// the PC plus the direction and the number of instructions since the
+// previous conditional branch (this one included). header.numInst is the
+// total instruction count, so MPKI stays exact. Written by tracepack -c.
+/////////////////////////////////////////
+
+#define COND_TRACE_MAGIC       "CBPCOND1"
+#define COND_TRACE_MAX_GAP     0x7fffffff
+
+typedef struct {
+  UINT32 PC;
+  UINT32 gapDir;                 // (instruction gap << 1) | branchTaken
+} COND_TRACE_RECORD;
+
+/////////////////////////////////////////
+// Chunked trace: same header, then the records in their gzip trace
+// layout (TRACE_RECORD_BYTES each), zlib compressed independently in
+// chunks of header.chunkRecords, then an index of the chunks at the end
+// of the file. Any instruction can be reached by inflating one chunk, so
+// the trace is portable, compact and seekable. Written by tracepack -z.
+/////////////////////////////////////////
+
+#define CHUNK_TRACE_MAGIC      "CBPCHNK1"
+
+typedef struct {
+  UINT64 offset;                 // of the compressed chunk in the file
+  UINT64 firstInst;              // instructions before the chunk
+  UINT32 compBytes;
+  UINT32 numRecs;
+} CHUNK_INDEX_ENTRY;
+
+/////////////////////////////////////////
+// Trace server (traceserver.cc): a daemon that decodes traces once and
+// keeps them resident as packed traces in sealed memory files. A client
+// sends the absolute path of a trace, NUL terminated, over the server's
+// Unix socket and gets back a TRACE_SERVER_REPLY with the memory file
+// attached (SCM_RIGHTS), which it maps like a packed trace file.
+/////////////////////////////////////////
+
+#define TRACE_SERVER_MSG_BYTES 256
+
+typedef struct {
+  INT32  status;                 // 0, else message says why not
+  char   message[TRACE_SERVER_MSG_BYTES];
+} TRACE_SERVER_REPLY;
+
 /////////////////////////////////////////
 /////////////////////////////////////////
 
 class CBP_TRACER{
  private:
-  FILE *traceFile;
+  gzFile traceFile;              // NULL when reading a packed trace
+  bool   condOnly;               // conditional-branch-only trace
+  bool   chunked;                // chunked trace
+  UINT64 traceTotalInst;         // from the header, 0 for a gzip trace
+
+  UINT8            *rawBlock;    // decompressed bytes, not yet parsed
+  UINT32            rawLen;
+  CBP_TRACE_RECORD *recBlock;    // parsed records handed out one by one
+  const CBP_TRACE_RECORD *recCur;
+  const CBP_TRACE_RECORD *recEnd;
+
+  void             *mapBase;     // mmap'd packed trace
+  size_t            mapBytes;
+  const CBP_TRACE_RECORD *recBase;   // first record of a packed trace
+
+  const CHUNK_INDEX_ENTRY *chunkIndex;
+  UINT64            numChunks;
+  UINT64            nextChunk;   // to inflate by the next FillBlock
+
+  const COND_TRACE_RECORD *condCur;  // not yet expanded into recBlock
+  const COND_TRACE_RECORD *condEnd;
+  UINT32           *gapBlock;    // instruction gap of each record in recBlock
+  const UINT32     *gapCur;
+  UINT64            condTotalInst;
+
+  // read ahead of a compressed trace: a thread inflates and parses
+  // blocks into the ring while the caller simulates
+  SPSC_RING<TRACE_BATCH> *ring;  // NULL when reading inline
+  std::thread      *reader;
+  std::atomic<bool> readerStop;
+  bool              readerDone;  // the end of trace batch was seen
+  bool              holdingBatch;
+  const char       *readError;   // why ReadBlock failed
 
   UINT64 numInst;        
   UINT64 numCondBranch;
 
-  UINT64 lastHeartBeat;
+  static const char *traceServer;  // socket of the trace server, NULL to open files
 
  public:
-  CBP_TRACER(char *traceFileName);
+  CBP_TRACER(char *traceFileName, bool readAhead=false);
+  ~CBP_TRACER();
+
+  static void SetTraceServer(const char *socketName){ traceServer = socketName; }
 
   bool   GetNextRecord(CBP_TRACE_RECORD *record);  
+  const CBP_TRACE_RECORD *NextRecord();  // NULL at end, no copy
+  void   Skip(UINT64 skipInst);
+  bool   Seek(UINT64 inst);      // packed and chunked traces only
+  bool   IsSeekable(){ return chunked || (traceFile == NULL && !condOnly); }
+  UINT64 GetTraceInst(){ return traceTotalInst; }
   UINT64 GetNumInst(){ return numInst; }
   UINT64 GetNumCondBranch(){ return numCondBranch; }
+  bool   IsCondOnly(){ return condOnly; }
 
  private:
-  void   CheckHeartBeat();
+  bool   OpenPacked(char *traceFileName);
+  bool   FillBlock();
+  bool   FillCondBlock();
+  void   LoadChunk(UINT64 chunk);
+  INT32  ReadBlock(CBP_TRACE_RECORD *block);
+  const char *GzReadError(int bytesRead);
+  void   DieReadError();
+  void   ReadAhead();
+  bool   NextBatch();
 };
 
 
+/////////////////////////////////////////
+// A whole trace reduced to its conditional branches and held in memory,
+// in the same records as a conditional-branch-only trace. Loaded once and
+// shared read-only by every predictor that replays it.
+/////////////////////////////////////////
+
+class COND_TRACE{
+ public:
+  COND_TRACE_RECORD *records;
+  UINT64             numRecords;
+  UINT64             numInst;
+
+  COND_TRACE(char *traceFileName);
+  ~COND_TRACE(){ free(records); }
+};
+
+bool WritePackedTrace(CBP_TRACER *tracer, int fd, TRACE_FILE_HEADER *header);
+
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+inline const CBP_TRACE_RECORD *CBP_TRACER::NextRecord(){
+
+  if(recCur == recEnd && !FillBlock()){
+    return NULL;
+  }
+
+  const CBP_TRACE_RECORD *rec = recCur++;
+
+  // update trace stats
+  if(condOnly){
+    numInst += *gapCur++;
+  }else{
+    numInst++;
+  }
+
+  // a mapped packed trace is not parsed, so its records are checked here
+  if((UINT32)rec->opType >= OPTYPE_MAX){
+    readError = "invalid record";
+    DieReadError();
+  }
+  if(rec->opType == OPTYPE_BRANCH_COND){
+    numCondBranch++;
+  }
+
+  return rec;
+}
+
+inline bool CBP_TRACER::GetNextRecord(CBP_TRACE_RECORD *rec){
+
+  const CBP_TRACE_RECORD *next = NextRecord();
+
+  if(next == NULL){
+    return FAILURE;
+  }
+
+  *rec = *next;
+  return SUCCESS; 
+}
+
+
 /////////////////////////////////////////
 /////////////////////////////////////////
 
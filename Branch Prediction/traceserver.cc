@@ -0,0 +1,366 @@
+/////////////////////////////////////////////////////////////////////////////////
+// traceserver: decode CBP traces once and keep them resident, so that
+// repeated predictor and sweep runs (-traceserver <socket>) map them from
+// memory instead of inflating them again. Each trace is held as a packed
+// trace in a sealed memory file that clients map read-only (see
+// TRACE_SERVER_REPLY in tracer.h); a loaded trace costs
+// sizeof(CBP_TRACE_RECORD) bytes per instruction.
+//
+// build: g++ -std=c++17 -O2 -pthread -o traceserver traceserver.cc tracer.cc -lz
+/////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "utils.h"
+#include "tracer.h"
+
+#define MAX_SERVED_TRACES    256
+#define SERVER_BACKLOG       64
+#define SERVER_RECV_TIMEOUT  5       // seconds a client has to send its request
+#define DECODE_NO_MEMORY     2       // exit status of a decoder that could not write
+
+// usage: traceserver [-maxmb <num>] <socket> [<trace> ...]
+//
+// Traces named on the command line are loaded up front, any other on its
+// first request. A trace is reloaded when its file changes. With -maxmb
+// the least recently served traces are dropped to stay under the limit;
+// clients that still map them are unaffected. Packed and conditional-
+// branch-only traces need no decoding and are passed through as they are.
+
+typedef struct {
+  char    path[PATH_MAX];
+  dev_t   dev;                   // of the trace file when it was loaded
+  ino_t   ino;
+  off_t   size;
+  time_t  mtime;
+  int     fd;                    // sealed memory file holding the packed trace
+  UINT64  numInst;
+  UINT64  bytes;
+  UINT64  lastUse;
+} SERVED_TRACE;
+
+SERVED_TRACE traces[MAX_SERVED_TRACES];
+UINT32       numTraces=0;
+UINT64       residentBytes=0;
+UINT64       maxBytes=0;         // 0 for no limit
+UINT64       useClock=0;
+const char  *socketName=NULL;
+
+void Shutdown(int){
+  unlink(socketName);
+  _exit(0);
+}
+
+/////////////////////////////////////////////////////////////
+// Decode the trace at path into a new memory file, then seal it so no
+// client can change it. The decoding runs in a child so a corrupt trace
+// fails this request rather than the server. Returns -1 with the reason
+// in error if the trace can not be decoded.
+/////////////////////////////////////////////////////////////
+
+int DecodeTrace(char *path, SERVED_TRACE *entry, char *error){
+
+  int fd = memfd_create("cbp_trace", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if(fd < 0){
+    snprintf(error, TRACE_SERVER_MSG_BYTES, "unable to create a memory file");
+    return -1;
+  }
+
+  fflush(stdout);
+  pid_t child = fork();
+  if(child < 0){
+    snprintf(error, TRACE_SERVER_MSG_BYTES, "unable to start decoding %s", path);
+    close(fd);
+    return -1;
+  }
+  if(child == 0){
+    signal(SIGINT,  SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    // the tracer dies on a trace it can not read
+    CBP_TRACER *tracer = new CBP_TRACER(path, true);
+    TRACE_FILE_HEADER header;
+    _exit(WritePackedTrace(tracer, fd, &header) ? 0 : DECODE_NO_MEMORY);
+  }
+
+  int status;
+  while(waitpid(child, &status, 0) < 0){
+    if(errno != EINTR){
+      status = -1;
+      break;
+    }
+  }
+
+  TRACE_FILE_HEADER header;
+  bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+  if(!ok && WIFEXITED(status) && WEXITSTATUS(status) == DECODE_NO_MEMORY){
+    snprintf(error, TRACE_SERVER_MSG_BYTES, "out of memory decoding %s", path);
+  }else if(!ok){
+    snprintf(error, TRACE_SERVER_MSG_BYTES, "unable to decode %s", path);
+  }else if(pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+	   fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0){
+    snprintf(error, TRACE_SERVER_MSG_BYTES, "unable to seal the memory file for %s", path);
+    ok = false;
+  }
+
+  if(!ok){
+    close(fd);
+    return -1;
+  }
+
+  entry->numInst = header.numInst;
+  entry->bytes   = sizeof(header) + header.numRecords*sizeof(CBP_TRACE_RECORD);
+  return fd;
+}
+
+// drop the least recently served traces until the resident ones fit,
+// but never the one in keepFd, which is about to be served
+void Evict(int keepFd){
+
+  while(maxBytes != 0 && residentBytes > maxBytes && numTraces > 1){
+    UINT32 victim = numTraces;
+
+    for(UINT32 ii=0; ii< numTraces; ii++){
+      if(traces[ii].fd != keepFd &&
+	 (victim == numTraces || traces[ii].lastUse < traces[victim].lastUse)){
+	victim = ii;
+      }
+    }
+
+    printf("Dropped %s\n", traces[victim].path);
+    close(traces[victim].fd);
+    residentBytes -= traces[victim].bytes;
+    traces[victim] = traces[--numTraces];
+  }
+}
+
+/////////////////////////////////////////////////////////////
+// Descriptor to send for the trace at path: its resident image, decoded
+// now if it is not loaded or its file changed since. *passThrough is
+// set when the file itself is sent, and the caller closes it.
+/////////////////////////////////////////////////////////////
+
+int ServeTrace(char *path, bool *passThrough, char *error){
+  struct stat st;
+  TRACE_FILE_HEADER header;
+
+  *passThrough = false;
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if(fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+    snprintf(error, TRACE_SERVER_MSG_BYTES, "unable to open %s", path);
+    if(fd >= 0){
+      close(fd);
+    }
+    return -1;
+  }
+
+  if(pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+     (!memcmp(header.magic, PACKED_TRACE_MAGIC, TRACE_MAGIC_BYTES) ||
+      !memcmp(header.magic, COND_TRACE_MAGIC, TRACE_MAGIC_BYTES))){
+    *passThrough = true;
+    return fd;
+  }
+  close(fd);
+
+  SERVED_TRACE *entry = NULL;
+  for(UINT32 ii=0; ii< numTraces && entry == NULL; ii++){
+    if(!strcmp(traces[ii].path, path)){
+      entry = &traces[ii];
+    }
+  }
+
+  if(entry != NULL && (entry->dev != st.st_dev || entry->ino != st.st_ino ||
+		       entry->size != st.st_size || entry->mtime != st.st_mtime)){
+    printf("Reloading %s\n", path);
+    close(entry->fd);
+    residentBytes -= entry->bytes;
+    *entry = traces[--numTraces];
+    entry = NULL;
+  }
+
+  if(entry == NULL){
+    SERVED_TRACE loaded;
+
+    if(numTraces == MAX_SERVED_TRACES){
+      snprintf(error, TRACE_SERVER_MSG_BYTES, "at most %d traces are served", MAX_SERVED_TRACES);
+      return -1;
+    }
+    if((loaded.fd = DecodeTrace(path, &loaded, error)) < 0){
+      return -1;
+    }
+    strcpy(loaded.path, path);
+    loaded.dev   = st.st_dev;
+    loaded.ino   = st.st_ino;
+    loaded.size  = st.st_size;
+    loaded.mtime = st.st_mtime;
+    loaded.lastUse = useClock;
+
+    traces[numTraces++] = loaded;
+    residentBytes += loaded.bytes;
+    printf("Loaded %s: %llu instructions, %llu MB\n", path, loaded.numInst, loaded.bytes>>20);
+
+    Evict(loaded.fd);
+    for(UINT32 ii=0; ii< numTraces; ii++){
+      if(traces[ii].fd == loaded.fd){
+	entry = &traces[ii];
+      }
+    }
+    fflush(stdout);
+  }
+
+  entry->lastUse = ++useClock;
+  return entry->fd;
+}
+
+void SendReply(int sock, int fd, const char *error){
+  TRACE_SERVER_REPLY reply;
+  char   control[CMSG_SPACE(sizeof(int))];
+  struct iovec  iov = { &reply, sizeof(reply) };
+  struct msghdr msg;
+
+  memset(&reply, 0, sizeof(reply));
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov    = &iov;
+  msg.msg_iovlen = 1;
+
+  if(fd < 0){
+    reply.status = -1;
+    strncpy(reply.message, error, TRACE_SERVER_MSG_BYTES-1);
+  }else{
+    memset(control, 0, sizeof(control));
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+  }
+
+  // a client that went away is not an error of the server
+  sendmsg(sock, &msg, MSG_NOSIGNAL);
+}
+
+// the path a client sends, NUL terminated; false if it sends none
+bool ReadRequest(int sock, char *path){
+  UINT32 len = 0;
+
+  while(len < PATH_MAX){
+    ssize_t got = read(sock, path+len, PATH_MAX-len);
+    if(got <= 0){
+      return false;
+    }
+    len += got;
+    if(memchr(path, 0, len) != NULL){
+      return path[0] == '/';
+    }
+  }
+  return false;
+}
+
+int main(int argc, char* argv[]){
+
+  int ii = 1;
+
+  if(argc > 2 && !strcmp(argv[1], "-maxmb")){
+    maxBytes = strtoull(argv[2], NULL, 10) << 20;
+    ii = 3;
+  }
+  if(ii >= argc){
+    printf("usage: %s [-maxmb <num>] <socket> [<trace> ...]\n", argv[0]);
+    printf("       -maxmb drops the least recently served traces above <num> MB\n");
+    exit(-1);
+  }
+  socketName = argv[ii++];
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(strlen(socketName) >= sizeof(addr.sun_path)){
+    printf("Socket name %s is too long\n", socketName);
+    exit(-1);
+  }
+  strcpy(addr.sun_path, socketName);
+
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(sock < 0){
+    printf("Unable to create the socket. Dying\n");
+    exit(-1);
+  }
+
+  // a socket nobody listens on is left over from a server that died
+  if(connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0){
+    printf("A trace server is already running on %s\n", socketName);
+    exit(-1);
+  }
+  unlink(socketName);
+
+  // only this user may ask the server to read files
+  mode_t oldMask = umask(0077);
+  if(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(sock, SERVER_BACKLOG) != 0){
+    printf("Unable to listen on %s. Dying\n", socketName);
+    exit(-1);
+  }
+  umask(oldMask);
+
+  signal(SIGINT,  Shutdown);
+  signal(SIGTERM, Shutdown);
+  signal(SIGPIPE, SIG_IGN);
+
+  ///////////////////////////////////////////////
+  // preload, then serve one request per connection
+  ///////////////////////////////////////////////
+
+  for(; ii< argc; ii++){
+    char path[PATH_MAX];
+    char error[TRACE_SERVER_MSG_BYTES];
+    bool passThrough;
+
+    int fd = (realpath(argv[ii], path) != NULL) ? ServeTrace(path, &passThrough, error) : -1;
+    if(fd < 0){
+      printf("Unable to load %s\n", argv[ii]);
+    }else if(passThrough){
+      close(fd);
+    }
+  }
+
+  printf("Serving traces on %s\n", socketName);
+  fflush(stdout);
+
+  for(;;){
+    char path[PATH_MAX];
+    char error[TRACE_SERVER_MSG_BYTES];
+    bool passThrough = false;
+    int  fd = -1;
+
+    int client = accept(sock, NULL, NULL);
+    if(client < 0){
+      continue;
+    }
+
+    struct timeval timeout = { SERVER_RECV_TIMEOUT, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if(ReadRequest(client, path)){
+      fd = ServeTrace(path, &passThrough, error);
+      SendReply(client, fd, error);
+    }
+    if(passThrough){
+      close(fd);
+    }
+    close(client);
+  }
+
+  return 0;
+}
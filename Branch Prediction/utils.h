@@ -8,6 +8,10 @@
 
 using namespace std;
 
+#define INT8        signed char
+#define UINT8       unsigned char
+#define INT16       short
+#define UINT16      unsigned short
 #define UINT32      unsigned int
 #define INT32       int
 #define UINT64      unsigned long long
@@ -10,6 +10,10 @@
 #include <string.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>    // link with -pthread
+#include <stdatomic.h>
 
 #include "types.h"
 #include "memsys.h"
@@ -17,6 +21,29 @@
 #define PRINT_DOTS   1
 #define DOT_INTERVAL 100000
 
+/***************************************************************************
+ * Trace read ahead: a reader thread freads the trace in large blocks and
+ * parses them into batches of records in a single-producer/single-consumer
+ * ring, so the simulation loop never waits on the gunzip pipe.
+ **************************************************************************/
+
+#define TRACE_RECORD_BYTES   9          // inst_addr(4) inst_type(1) ldst_addr(4)
+#define TRACE_BATCH_RECORDS  (1<<14)
+#define TRACE_RING_SLOTS     4          // power of two
+#define TRACE_RING_SPINS     64         // yields before sleeping
+#define TRACE_RING_MAX_NAP   256        // longest sleep in microseconds
+
+typedef struct Trace_Rec {
+    Addr       inst_addr;
+    Addr       ldst_addr;
+    Inst_Type  inst_type;
+} Trace_Rec;
+
+typedef struct Trace_Batch {
+    uns        num_recs;                // 0 marks the end of the trace
+    Trace_Rec  recs[TRACE_BATCH_RECORDS];
+} Trace_Batch;
+
 /***************************************************************************
  * Globals 
  **************************************************************************/
@@ -43,6 +70,9 @@ void die_usage();
 void die_message(const char * msg);
 void get_params(int argc, char** argv);
 void print_stats();
+void trace_ring_wait(uns *spins);
+void *trace_reader(void *arg);
+Trace_Batch *trace_next_batch(Trace_Batch *done_batch);
 
 /***************************************************************************************
  * Globals
@@ -53,19 +83,30 @@ uns64       cycle_count;
 uns64       inst_count; 
 uns64       last_printdot_inst;
 
+Trace_Batch   trace_ring[TRACE_RING_SLOTS];
+atomic_uint   trace_ring_head;         // batches consumed, written by main
+atomic_uint   trace_ring_tail;         // batches produced, written by the reader
+pthread_t     trace_reader_thread;
+
 
 /***************************************************************************************
  * Main
  ***************************************************************************************/
 int main(int argc, char** argv)
 {
-    Flag tmp, done=0;
+    Flag done=0;
+    Trace_Batch *batch=NULL;
+    uns batch_pos=0;
 
     srand(42);
     get_params(argc, argv);
     memsys = memsys_new();
     print_dots();
 
+    if(pthread_create(&trace_reader_thread, NULL, trace_reader, NULL)){
+      die_message("Unable to start the trace reader thread");
+    }
+
     //--------------------------------------------------------------------
     // -- Iterate through the traces until done
     //--------------------------------------------------------------------
@@ -77,15 +118,21 @@ int main(int argc, char** argv)
 
       //------ read the trace record for each instruction ----------------      
 
-      tmp = fread (&inst_addr, 4, 1, trfile);
-      tmp = fread (&inst_type, 1, 1, trfile);
-      tmp = fread (&ldst_addr, 4, 1, trfile);
+      if(batch == NULL || batch_pos == batch->num_recs){
+	batch = trace_next_batch(batch);
+	batch_pos = 0;
+      }
 
-      if(feof(trfile)){
+      if(batch->num_recs == 0){
 	done=TRUE;
 	break;
       }
 
+      inst_addr = batch->recs[batch_pos].inst_addr;
+      inst_type = batch->recs[batch_pos].inst_type;
+      ldst_addr = batch->recs[batch_pos].ldst_addr;
+      batch_pos++;
+
       //------ access the memory system ----------------------------------
 
       ifetch_delay = memsys_access(memsys, inst_addr, ACCESS_TYPE_IFETCH);
@@ -124,11 +171,97 @@ int main(int argc, char** argv)
       
     }
 
+    pthread_join(trace_reader_thread, NULL);
     print_stats();
     return 0;
 
 }
 
+//--------------------------------------------------------------------
+// -- Wait for the other side of the ring: yield a while, then sleep
+// -- with doubling naps so a long wait does not hold a core
+//--------------------------------------------------------------------
+
+void trace_ring_wait(uns *spins){
+  if(*spins < TRACE_RING_SPINS){
+    sched_yield();
+  }else{
+    uns nap = 1u << (*spins - TRACE_RING_SPINS);
+    struct timespec ts = { 0, 1000L * (nap < TRACE_RING_MAX_NAP ? nap : TRACE_RING_MAX_NAP) };
+
+    nanosleep(&ts, NULL);
+    if(nap >= TRACE_RING_MAX_NAP){
+      return;
+    }
+  }
+  (*spins)++;
+}
+
+//--------------------------------------------------------------------
+// -- Trace reader thread: fill ring slots until the end of the trace.
+// -- A partial record at the end is dropped, as feof did before.
+//--------------------------------------------------------------------
+
+void *trace_reader(void *arg){
+  uns8 *raw = (uns8 *) malloc(TRACE_BATCH_RECORDS*TRACE_RECORD_BYTES);
+  uns   tail = 0;
+  uns   ii, num_recs;
+
+  if(raw == NULL){
+    die_message("Out of memory for the trace reader");
+  }
+
+  do{
+    // wait for a free slot
+    uns spins = 0;
+    while(tail - atomic_load_explicit(&trace_ring_head, memory_order_acquire) == TRACE_RING_SLOTS){
+      trace_ring_wait(&spins);
+    }
+
+    Trace_Batch *batch = &trace_ring[tail % TRACE_RING_SLOTS];
+
+    num_recs = fread(raw, 1, TRACE_BATCH_RECORDS*TRACE_RECORD_BYTES, trfile) / TRACE_RECORD_BYTES;
+
+    for(ii=0; ii< num_recs; ii++){
+      uns8 *src = raw + ii*TRACE_RECORD_BYTES;
+      uns32 inst_addr, ldst_addr;
+
+      memcpy(&inst_addr, src,   4);
+      memcpy(&ldst_addr, src+5, 4);
+      batch->recs[ii].inst_addr = inst_addr;
+      batch->recs[ii].inst_type = (Inst_Type) src[4];
+      batch->recs[ii].ldst_addr = ldst_addr;
+    }
+    batch->num_recs = num_recs;
+
+    tail++;
+    atomic_store_explicit(&trace_ring_tail, tail, memory_order_release);
+  }while(num_recs != 0);
+
+  free(raw);
+  return NULL;
+}
+
+//--------------------------------------------------------------------
+// -- Hand done_batch (if any) back to the reader, wait for the next one
+//--------------------------------------------------------------------
+
+Trace_Batch *trace_next_batch(Trace_Batch *done_batch){
+  uns head = atomic_load_explicit(&trace_ring_head, memory_order_relaxed);
+
+  if(done_batch != NULL){
+    head++;
+    atomic_store_explicit(&trace_ring_head, head, memory_order_release);
+  }
+
+  uns spins = 0;
+  while(atomic_load_explicit(&trace_ring_tail, memory_order_acquire) == head){
+    trace_ring_wait(&spins);
+  }
+
+  return &trace_ring[head % TRACE_RING_SLOTS];
+}
+
 //--------------------------------------------------------------------
 // -- Print statistics
 //--------------------------------------------------------------------